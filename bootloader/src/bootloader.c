@@ -11,6 +11,9 @@
 #include <kernel/board.h>
 #include <kernel/i2c.h>
 #include <kernel/string.h>
+#include <kernel/lz4.h>
+#include <kernel/timer.h>
+#include <kernel/boottime.h>
 
 #ifdef PLATFORM_BBB
 unsigned int UARTBootCopy(void);
@@ -30,12 +33,12 @@ uint32_t kernel_code_end;
 /* bootloader C entry point */
 void loader(void){
 
-    // fat32 driver
-    fat32_fs_t boot_fs;
-    fat32_file_t kernel;
     int res = 0;
+    clock_timer.start_counter();
+    boot_stamp(BOOT_PHASE_LOADER_START);
     uart_driver.init();
     board_info.init();
+    boot_stamp(BOOT_PHASE_UART_INIT);
 
     printk("UART Active\n");
     printk("Loader loaded at %p\n", (void*)(uintptr_t)loader);
@@ -46,7 +49,9 @@ void loader(void){
     printk("Serial Number %s\n", board_info.serial_number);
     ccm_driver.init();
     dram_driver.init();
+    boot_stamp(BOOT_PHASE_DRAM_INIT);
     mmc_driver.init();
+    boot_stamp(BOOT_PHASE_MMC_INIT);
     printk("Done on BBB - need working MMU/MMC reads\n");
 
     mmu_driver.init();
@@ -77,6 +82,13 @@ void loader(void){
     kernel_entry();
 #endif
 #ifdef PLATFORM_QEMU
+    // fat32 driver
+    fat32_fs_t boot_fs;
+    fat32_file_t kernel;
+    fat32_file_t initramfs;
+    uint32_t kernel_size = 0;
+    uint32_t kernel_sum = 0;
+
     // map the rest of the memory into kernel space for the jump to kernel.
     for (uintptr_t i = DRAM_BASE; i < DRAM_BASE + DRAM_SIZE; i += PAGE_SIZE) {
         mmu_driver.map_page(NULL, (void*)(KERNEL_ENTRY + (i - DRAM_BASE)), (void*)i, L2_KERNEL_DATA_PAGE);
@@ -89,18 +101,56 @@ void loader(void){
 
     mmu_driver.enable();
     CHECK_FAIL(fat32_mount(&boot_fs, &mmc_fat32_diskio), "Failed to mount FAT32 filesystem");
-    CHECK_FAIL(fat32_open(&boot_fs, KERNEL_PATH, &kernel), "Failed to open kernel image");
-    CHECK_FAIL(kernel.file_size == 0, "Kernel image is empty");
-
-    /* Read kernel into DRAM */
-    if ((res = fat32_read(&kernel, (void*)KERNEL_ENTRY, kernel.file_size, 0)) < 0
-        || res != (int)kernel.file_size) {
-        printk("Bootloader failed: Failed to read entire kernel into memory! (Read %d bytes, expected %d)\n", res, kernel.file_size);
-        goto bootloader_fail;
+    boot_stamp(BOOT_PHASE_FAT_MOUNT);
+
+    /* Read the compressed kernel and unpack it to KERNEL_ENTRY, it's far less to pull off the card */
+    if (fat32_open(&boot_fs, KERNEL_LZ4_PATH, &kernel) == 0 && kernel.file_size > 0) {
+        if ((res = fat32_read(&kernel, (void*)KERNEL_STAGING_ADDR, kernel.file_size, 0)) < 0
+            || res != (int)kernel.file_size) {
+            printk("Bootloader failed: Failed to read compressed kernel into memory! (Read %d bytes, expected %d)\n", res, kernel.file_size);
+            goto bootloader_fail;
+        }
+        fat32_close(&kernel);
+        boot_stamp(BOOT_PHASE_KERNEL_READ);
+
+        CHECK_FAIL(lz4_frame_decompress((void*)KERNEL_STAGING_ADDR, kernel.file_size, (void*)KERNEL_ENTRY, KERNEL_MAX_SIZE, &kernel_sum),
+            "Failed to decompress kernel image");
+        kernel_size = res;
+        boot_stamp(BOOT_PHASE_KERNEL_UNPACK);
+        printk("Decompressed kernel: %d -> %d bytes\n", kernel.file_size, kernel_size);
+    } else {
+        /* Fall back to the uncompressed image */
+        CHECK_FAIL(fat32_open(&boot_fs, KERNEL_PATH, &kernel), "Failed to open kernel image");
+        CHECK_FAIL(kernel.file_size == 0, "Kernel image is empty");
+
+        if ((res = fat32_read(&kernel, (void*)KERNEL_ENTRY, kernel.file_size, 0)) < 0
+            || res != (int)kernel.file_size) {
+            printk("Bootloader failed: Failed to read entire kernel into memory! (Read %d bytes, expected %d)\n", res, kernel.file_size);
+            goto bootloader_fail;
+        }
+        kernel_size = kernel.file_size;
+        kernel_sum = calculate_checksum((void*)KERNEL_ENTRY, kernel_size);
+        fat32_close(&kernel);
+        boot_stamp(BOOT_PHASE_KERNEL_READ);
+    }
+
+    /* Read the initramfs (if there is one) while the card is already mounted */
+    uint32_t initramfs_size = 0;
+    if (fat32_open(&boot_fs, INITRAMFS_PATH, &initramfs) == 0 && initramfs.file_size > 0) {
+        if ((res = fat32_read(&initramfs, (void*)INITRAMFS_LOAD_ADDR, initramfs.file_size, 0)) < 0
+            || res != (int)initramfs.file_size) {
+            printk("Bootloader failed: Failed to read initramfs into memory! (Read %d bytes, expected %d)\n", res, initramfs.file_size);
+            goto bootloader_fail;
+        }
+        initramfs_size = initramfs.file_size;
+        fat32_close(&initramfs);
+        boot_stamp(BOOT_PHASE_INITRAMFS_READ);
+    } else {
+        printk("No initramfs found at " INITRAMFS_PATH ", the kernel will load /elf and /bin from the card\n");
     }
 
     /* jump to kernel memory space */
-    JUMP_KERNEL(kernel);
+    JUMP_KERNEL(kernel_size, kernel_sum, initramfs_size ? INITRAMFS_LOAD_ADDR : 0, initramfs_size);
 #endif
     // If we get here, the kernel failed to load, or bailed out
     printk("Failed to load kernel with error code %d! Halting!\n", res);
@@ -0,0 +1,68 @@
+// DMTIMER2 as a free running counter, enough for boot stamps. No interrupts yet, so the
+// top half of the tick count is kept up by whoever reads it, which is fine as long as
+// reads are less than a wrap (~179s at 24MHz) apart, like they are during boot.
+#include <stdint.h>
+#include <kernel/timer.h>
+#include "utils.h"
+#include "ccm.h"
+
+#define DMTIMER2_BASE           0x48040000
+#define DMTIMER_TCLR            0x38
+#define DMTIMER_TCRR            0x3C
+#define DMTIMER_TLDR            0x40
+#define DMTIMER_TCLR_ST         (1 << 0)
+#define DMTIMER_TCLR_AR         (1 << 1)
+
+#define CM_DPLL_CLKSEL_TIMER2   0x08
+#define CLKSEL_CLK_M_OSC        0x1
+
+#define TIMER_FREQ 24000000ULL // CLK_M_OSC, the 24MHz crystal
+
+static uint32_t last_count;
+
+static void timer_start_counter(void) {
+    if (REG32_read(DMTIMER2_BASE, DMTIMER_TCLR) & DMTIMER_TCLR_ST) return;
+
+    REG32_write(CM_DPLL_BASE, CM_DPLL_CLKSEL_TIMER2, CLKSEL_CLK_M_OSC);
+    REG32_write(CM_PER_BASE, CM_PER_TIMER2_CLKCTRL, 0x2);
+    while ((REG32_read(CM_PER_BASE, CM_PER_TIMER2_CLKCTRL) & (0x3 << 16)) != 0x0);
+
+    REG32_write(DMTIMER2_BASE, DMTIMER_TLDR, 0);
+    REG32_write(DMTIMER2_BASE, DMTIMER_TCRR, 0);
+    REG32_write(DMTIMER2_BASE, DMTIMER_TCLR, DMTIMER_TCLR_ST | DMTIMER_TCLR_AR);
+}
+
+static uint64_t get_ticks(void) {
+    uint32_t count = REG32_read(DMTIMER2_BASE, DMTIMER_TCRR);
+    if (count < last_count) clock_timer.global_ticks += 0x100000000ULL;
+    last_count = count;
+    return (clock_timer.global_ticks & ~0xFFFFFFFFULL) | count;
+}
+
+static uint64_t ticks_to_us(uint64_t ticks) {
+    return (ticks * 1000000ULL) / TIMER_FREQ;
+}
+
+static uint64_t us_to_ticks(uint64_t us) {
+    return (us * TIMER_FREQ) / 1000000ULL;
+}
+
+static uint64_t ticks_to_ms(uint64_t ticks) {
+    return (ticks * 1000ULL) / TIMER_FREQ;
+}
+
+static uint64_t ms_to_ticks(uint64_t ms) {
+    return (ms * TIMER_FREQ) / 1000ULL;
+}
+
+timer_t clock_timer = {
+    .available = 0,
+    .total = 0,
+    .start_counter = timer_start_counter,
+    .get_ticks = get_ticks,
+
+    .ticks_to_us = ticks_to_us,
+    .us_to_ticks = us_to_ticks,
+    .ticks_to_ms = ticks_to_ms,
+    .ms_to_ticks = ms_to_ticks,
+};
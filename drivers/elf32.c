@@ -86,6 +86,7 @@ binary_t* load_elf32(uint8_t* bytes, size_t size) {
     binary->data.elf.file_type = header->e_type;
     binary->data.elf.architecture = header->e_machine;
     binary->data.elf.header = header;
+    binary->data.elf.flags = 0;
 
     // Set up program headers
     binary->data.elf.program_headers = (elf_program_header_t*)(bytes + header->e_phoff);
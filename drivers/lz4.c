@@ -0,0 +1,155 @@
+// LZ4 frame decompression, enough to unpack images written by `lz4 -9 --content-size`
+// https://github.com/lz4/lz4/blob/dev/doc/lz4_Frame_format.md
+#include <stdint.h>
+#include <stddef.h>
+
+#include <kernel/lz4.h>
+#include <kernel/boot.h>
+#include <kernel/errno.h>
+#include <kernel/string.h>
+
+#define LZ4_FLG_VERSION_MASK   0xC0
+#define LZ4_FLG_VERSION        0x40
+#define LZ4_FLG_BLOCK_CHECKSUM 0x10
+#define LZ4_FLG_CONTENT_SIZE   0x08
+#define LZ4_FLG_CONTENT_CHECKSUM 0x04
+#define LZ4_FLG_DICT_ID        0x01
+
+#define LZ4_BLOCK_UNCOMPRESSED 0x80000000U
+#define LZ4_MIN_MATCH 4
+
+static inline uint32_t lz4_read32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// decode one block into op. matches may reach back to base, so linked blocks work too
+static int lz4_decode(const uint8_t* ip, size_t len, uint8_t* base, uint8_t* op, uint8_t* oend) {
+    const uint8_t* iend = ip + len;
+    uint8_t* ostart = op;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        // literals
+        size_t literals = token >> 4;
+        if (literals == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -EINVAL;
+                b = *ip++;
+                literals += b;
+            } while (b == 255);
+        }
+
+        if (literals > (size_t)(iend - ip) || literals > (size_t)(oend - op)) return -EINVAL;
+        memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+
+        // the last sequence is literals only
+        if (ip >= iend) break;
+
+        // match
+        if (iend - ip < 2) return -EINVAL;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - base)) return -EINVAL;
+
+        size_t match_len = token & 0xF;
+        if (match_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -EINVAL;
+                b = *ip++;
+                match_len += b;
+            } while (b == 255);
+        }
+        match_len += LZ4_MIN_MATCH;
+        if (match_len > (size_t)(oend - op)) return -EINVAL;
+
+        const uint8_t* match = op - offset;
+        if (offset >= match_len) {
+            memcpy(op, match, match_len);
+            op += match_len;
+        } else {
+            // overlapping copy repeats the last offset bytes, has to go forwards a byte at a time
+            while (match_len--) *op++ = *match++;
+        }
+    }
+
+    return op - ostart;
+}
+
+int lz4_block_decompress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_cap) {
+    return lz4_decode(src, src_len, dst, dst, dst + dst_cap);
+}
+
+int lz4_frame_decompress(const void* src, size_t src_len, void* dst, size_t dst_cap, uint32_t* checksum) {
+    const uint8_t* ip = (const uint8_t*)src;
+    const uint8_t* iend = ip + src_len;
+    uint8_t* base = (uint8_t*)dst;
+    uint8_t* op = base;
+    uint8_t* oend = base + dst_cap;
+
+    if (src_len < 7 || lz4_read32(ip) != LZ4_FRAME_MAGIC) return -EINVAL;
+    ip += 4;
+
+    // frame descriptor
+    const uint8_t* descriptor = ip;
+    uint8_t flg = *ip++;
+    ip++; // BD, max block size doesn't matter when decoding into one buffer
+
+    if ((flg & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION) return -EINVAL;
+    if (flg & LZ4_FLG_DICT_ID) return -ENOTSUP;
+
+    uint32_t content_size = 0;
+    if (flg & LZ4_FLG_CONTENT_SIZE) {
+        if (iend - ip < 9) return -EINVAL;
+        // 64-bit field, anything past 4GB won't fit anyway
+        if (lz4_read32(ip + 4) != 0) return -EINVAL;
+        content_size = lz4_read32(ip);
+        if (content_size > dst_cap) return -EINVAL;
+        ip += 8;
+    }
+
+    uint8_t header_checksum = (calculate_checksum(descriptor, ip - descriptor) >> 8) & 0xFF;
+    if (ip >= iend || *ip++ != header_checksum) return -EINVAL;
+
+    // blocks, terminated by a zero size
+    for (;;) {
+        if (iend - ip < 4) return -EINVAL;
+        uint32_t block_size = lz4_read32(ip);
+        ip += 4;
+        if (block_size == 0) break;
+
+        int uncompressed = block_size & LZ4_BLOCK_UNCOMPRESSED;
+        block_size &= ~LZ4_BLOCK_UNCOMPRESSED;
+        if (block_size > (size_t)(iend - ip)) return -EINVAL;
+
+        if (uncompressed) {
+            if (block_size > (size_t)(oend - op)) return -EINVAL;
+            memcpy(op, ip, block_size);
+            op += block_size;
+        } else {
+            int res = lz4_decode(ip, block_size, base, op, oend);
+            if (res < 0) return res;
+            op += res;
+        }
+        ip += block_size;
+
+        if (flg & LZ4_FLG_BLOCK_CHECKSUM) ip += 4;
+    }
+
+    if ((flg & LZ4_FLG_CONTENT_SIZE) && (uint32_t)(op - base) != content_size) return -EIO;
+
+    if (flg & LZ4_FLG_CONTENT_CHECKSUM) {
+        if (iend - ip < 4) return -EINVAL;
+        uint32_t sum = calculate_checksum(base, op - base);
+        if (sum != lz4_read32(ip)) return -EIO;
+        if (checksum) *checksum = sum;
+    } else if (checksum) {
+        *checksum = calculate_checksum(base, op - base);
+    }
+
+    return op - base;
+}
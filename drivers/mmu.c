@@ -25,7 +25,7 @@ uint32_t alloc_l1_table(struct page_allocator *alloc) {
     if(!addr) return 0;
 
     // Initialize L1 table
-    memset(PHYS_TO_KERNEL_VIRT(addr), 0, 16*1024);
+    for (int i = 0; i < 4; i++) clear_page((uint8_t*)PHYS_TO_KERNEL_VIRT(addr) + i * PAGE_SIZE);
     return (uint32_t)addr;
 }
 #endif
@@ -198,6 +198,28 @@ void unmap_page(void* ttbr0, void* vaddr) {
     l2_table[PAGE_INDEX((uint32_t)vaddr)] = 0;
 }
 
+#ifndef BOOTLOADER
+// map_page gives every L2 table a page of its own, so each one goes straight back
+void free_user_tables(uint32_t* ttbr0) {
+    uint32_t* l1 = PHYS_TO_KERNEL_VIRT(ttbr0);
+
+    for (uint32_t section = 0; section < USER_L1_ENTRIES; section++) {
+        if ((l1[section] & 0x3) != MMU_PAGE_DESCRIPTOR) continue;
+
+        free_page(&kpage_allocator, (void*)(l1[section] & ~0xFFF));
+        l1[section] = 0;
+    }
+}
+
+uint32_t* get_pte(uint32_t* ttbr0, void* vaddr) {
+    uint32_t l1_entry = PHYS_TO_KERNEL_VIRT(ttbr0)[SECTION_INDEX((uint32_t)vaddr)];
+    if ((l1_entry & 0x3) != MMU_PAGE_DESCRIPTOR) return NULL;
+
+    uint32_t* l2_table = PHYS_TO_KERNEL_VIRT(l1_entry & ~0x3FF);
+    return &l2_table[PAGE_INDEX((uint32_t)vaddr)];
+}
+#endif
+
 void set_l1_page_table(uint32_t *l1_page_table) {
     mmu_driver.ttbr0 = l1_page_table;
     __asm__ volatile(
@@ -11,21 +11,22 @@
 #include <kernel/mmu.h>
 #include <kernel/errno.h>
 #include <kernel/panic.h>
+#include <kernel/mm.h>
+#include <kernel/vma.h>
 
 // handle interrupts here
 uint32_t svc_handlers[NR_SYSCALLS] = {0};
 
 void handle_svc_c(
-    uint32_t svc_number,  // SVC number (extracted from instruction)
-    uint32_t* sp) {
-    current_process->stack_top = sp;
+    uint32_t svc_number,  // SVC number (from r7)
+    struct trapframe* tf) {
     LOG_SYSCALL(svc_number);
     if (svc_number > NR_SYSCALLS) {
-        sp[0] = -ENOSYS;
+        tf->r[0] = -ENOSYS;
         return;
     }
 
-    handle_syscall(svc_number, sp[0], sp[1], sp[2], sp[3]);
+    handle_syscall(svc_number, tf->r[0], tf->r[1], tf->r[2], tf->r[3]);
 }
 
 void data_abort_handler(uint32_t lr) {
@@ -67,7 +68,7 @@ void data_abort_handler(uint32_t lr) {
         default: printk("Reserved fault status\n"); break;
     }
 
-    printk("Returning to LR: %p\n", lr);
+    printk("Faulting pc: %p\n", lr);
 
     // Kernel panic or recovery logic
     panic("Stopping");
@@ -75,6 +76,45 @@ void data_abort_handler(uint32_t lr) {
 
 
 
+// short descriptor fault status, DFSR[10] and DFSR[3:0]
+#define FSR_TRANSLATION_SECTION 0x05
+#define FSR_TRANSLATION_PAGE    0x07
+#define FSR_PERMISSION_PAGE     0x0F // also the first write to a page still on the zero page
+#define DFSR_WNR                (1 << 11) // the access was a write
+
+// Aborts from userspace and from syscalls touching user memory. A translation fault in
+// one of the process's areas is a page that hasn't been touched yet, fault it in and retry.
+// Anything else kills the process, or stops the kernel if it wasn't touching user memory
+void data_abort_c(struct trapframe* tf, uint32_t pc) {
+    uint32_t dfsr, dfar;
+    __asm__ volatile("mrc p15, 0, %0, c5, c0, 0" : "=r"(dfsr));
+    __asm__ volatile("mrc p15, 0, %0, c6, c0, 0" : "=r"(dfar));
+
+    uint32_t status = (dfsr & 0xF) | ((dfsr >> 6) & 0x10);
+    int write = (dfsr & DFSR_WNR) != 0;
+
+    int err = -EFAULT;
+    if (current_process && dfar < KERNEL_DIVIDER
+        && (status == FSR_TRANSLATION_SECTION || status == FSR_TRANSLATION_PAGE || status == FSR_PERMISSION_PAGE)) {
+        err = vma_fault(process_mm(current_process), current_process->ttbr0, dfar, write);
+        if (err == 0) return;
+    }
+
+    // a syscall tripping over a bad user pointer takes the process down too, not the kernel
+    int user_access = tf || (dfar < KERNEL_DIVIDER && current_process && !(current_process->flags & PROCESS_FLAG_KTHREAD));
+    if (user_access) {
+        const char* what = (err == -EOVERFLOW) ? "stack overflow"
+                         : (err == -ENOMEM) ? "out of memory"
+                         : (err == -EIO) ? "swap read failed"
+                         : write ? "bad write" : "bad read";
+        LOG(WARN, "pid %d: %s at %p (pc %p, status %p), killed\n", current_process->pid, what, dfar, pc, status);
+        process_exit(-1);
+    }
+
+    data_abort_handler(pc);
+}
+
+
 void prefetch_abort_c(void) {
     uint32_t ifar, ifsr;
     __asm__ volatile("mrc p15, 0, %0, c6, c0, 2" : "=r"(ifar)); // IFAR
@@ -94,11 +134,11 @@ void handle_undefined(uint32_t esr, process_t* p) {
     printk("ESR: %p (EC=%p IL=%d ISS=%p)\n",
            esr, ec, il, iss);
 
-    // Mark process as killed
-    p->state = PROCESS_KILLED;
-
     // Optional: Dump register state
     // #ifdef DEBUG
     // dump_registers(&p->regs);
     // #endif
+
+    // kill it, frees everything and leaves the exit status for the parent
+    process_exit(-1);
 }
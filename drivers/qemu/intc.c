@@ -8,6 +8,7 @@
 #include <kernel/sched.h>
 #include <kernel/string.h>
 #include <kernel/log.h>
+#include <kernel/softirq.h>
 
 #include "intc.h"
 
@@ -21,11 +22,8 @@ extern uint32_t _vectors[];
 void handle_irq_c(uint32_t process_stack) {
     uint32_t pending, irq;
 
-    // if process_stack != 0, we came from a process, otherwise we came from kernel
-    if (process_stack) {
-        current_process->stack_top = (uint32_t*)process_stack;
-    }
-
+    // process_stack is the trapframe if we came from a process, 0 if we came from the kernel
+    (void)process_stack;
 
     for(int reg = 0; reg < 3; reg++) {
         pending = INTC->IRQ_PEND[reg];
@@ -38,6 +36,9 @@ void handle_irq_c(uint32_t process_stack) {
             pending &= pending - 1;
         }
     }
+
+    // handlers above only did the urgent part, the rest runs now with IRQs back on
+    irq_exit();
 }
 
 #ifndef BOOTLOADER
@@ -16,6 +16,8 @@ extern void mmu_set_domains(void);
 extern void mmu_enable(void);
 extern void map_page(void *ttbr0, void* vaddr, void* paddr, uint32_t flags);
 extern void unmap_page(void* tbbr0, void* vaddr);
+extern void free_user_tables(uint32_t* ttbr0);
+extern uint32_t* get_pte(uint32_t* ttbr0, void* vaddr);
 extern void invalidate_all_tlb(void);
 extern void set_l1_page_table(uint32_t *l1_page_table);
 int check_if_user_addr(uint32_t vaddr, uint32_t len);
@@ -195,6 +197,10 @@ mmu_t mmu_driver = {
     .enable = mmu_enable,
     .map_page = map_page,
     .unmap_page = unmap_page,
+#ifndef BOOTLOADER
+    .free_user_tables = free_user_tables,
+    .get_pte = get_pte,
+#endif
     .flush_tlb = invalidate_all_tlb,
     .set_l1_table = set_l1_page_table,
     .get_physical_address = get_physical_address,
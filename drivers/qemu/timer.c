@@ -4,9 +4,17 @@
 #include <kernel/intc.h>
 #include <kernel/timer.h>
 #include <kernel/panic.h>
+#include <kernel/softirq.h>
+#include <kernel/int.h>
 
 #include "timer.h"
 
+// timer idx bits, set by the irq and handed over to timer_softirq
+static volatile uint32_t timer_fired;
+static uint32_t timer_oneshot; // fired ones that get unregistered after their callback
+
+static void timer_softirq(void);
+
 // handle reset timer for system clock (TIMER1)
 void handle_irq(int irq, void* data) {
     (void)irq, (void)data;
@@ -16,11 +24,18 @@ void handle_irq(int irq, void* data) {
     }
 }
 
+// free running count on the system clock. if the bootloader already started it, leave it
+// alone so the kernel keeps counting from power on (boot stamps depend on this)
+static void timer_start_counter(void) {
+    if (TIMER0->timer[TIMER1_IDX].control & TIMER_ENABLE) return;
+
+    TIMER0->timer[TIMER1_IDX].interval = 0xFFFFFFFF; // Max interval (32-bit)
+    TIMER0->timer[TIMER1_IDX].control = TIMER_ENABLE | TIMER_RELOAD | TIMER_CLK_SRC_OSC24M;
+}
+
 static void system_tick_clock(int idx) {
     TIMER0->irq_enable = (1 << idx);
-    TIMER0->timer[idx].interval = 0xFFFFFFFF; // Max interval (32-bit)
-
-    TIMER0->timer[idx].control = TIMER_ENABLE | TIMER_RELOAD | TIMER_CLK_SRC_OSC24M;
+    timer_start_counter();
 
     interrupt_controller.register_irq(get_timer_irq_idx(idx), handle_irq, NULL);
     interrupt_controller.enable_irq(get_timer_irq_idx(idx));
@@ -29,6 +44,7 @@ static void system_tick_clock(int idx) {
 static void timer_init(void) {
     clock_timer.global_ticks = 0;
     clock_timer.initialized = 1;
+    open_softirq(SOFTIRQ_TIMER, timer_softirq);
     system_tick_clock(TIMER1_IDX); // TODO this should be a high IDX
 }
 
@@ -42,14 +58,34 @@ void handle_callback(int irq, void* data) {
     // reset the timer
     AW_Timer *t = (AW_Timer*) TIMER_BASE;
     t->irq_status ^= (get_timer_idx_from_irq(irq) << 0);
-    // call the callback
-    clock_timer.callbacks[timer_idx]();
+
+    // the callback runs as a softirq, here we only note which timer fired
+    timer_fired |= 1 << timer_idx;
+    raise_softirq(SOFTIRQ_TIMER);
 }
 
 void handle_oneshot_callback(int irq, void* data) {
+    timer_oneshot |= 1 << get_timer_idx_from_irq(irq);
     handle_callback(irq, data);
-    clock_timer.callbacks[get_timer_idx_from_irq(irq)] = NULL;
-    clock_timer.available++;
+}
+
+static void timer_softirq(void) {
+    uint32_t flags = local_irq_save();
+    uint32_t fired = timer_fired;
+    uint32_t oneshot = timer_oneshot & fired;
+    timer_fired = 0;
+    timer_oneshot &= ~oneshot;
+    local_irq_restore(flags);
+
+    while (fired) {
+        uint32_t idx = __builtin_ctz(fired);
+        if (clock_timer.callbacks[idx]) clock_timer.callbacks[idx]();
+        if (oneshot & (1 << idx)) {
+            clock_timer.callbacks[idx] = NULL;
+            clock_timer.available++;
+        }
+        fired &= fired - 1;
+    }
 }
 
 void timer_start_callback(uint32_t timer_idx, uint32_t interval_us, timer_callback_t callback) {
@@ -116,6 +152,7 @@ timer_t clock_timer = {
     .available = 5,    // there are 6, but one is reserved for clock and never exported
     .total = 5,        // there are 6, but one is reserved for clock and never exported
     .init = timer_init,
+    .start_counter = timer_start_counter,
     // .start_idx = timer_start,
     .start_idx_callback = timer_start_callback,
     .get_ticks = get_ticks,
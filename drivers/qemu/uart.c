@@ -4,11 +4,38 @@
 #include <kernel/printk.h>
 #include <kernel/intc.h>
 #include <kernel/panic.h>
+#include <kernel/ring.h>
+#include <kernel/int.h>
+#include <kernel/softirq.h>
 #include "uart.h"
 #include "intc.h"
 
 // UART0 Base Allwinner A10 (Cubieboard)
 
+#define UART_TX_BUFFER_SIZE 1024
+#define UART_RX_BUFFER_SIZE 1024
+
+// rx irq once the FIFO is half full, the character timeout irq picks up anything shorter
+#define UART_FCR_SETUP (UART_FCR_FIFO_EN | UART_FCR_RX_RESET | UART_FCR_RX_TRIG_8)
+
+// bytes waiting for the THR empty irq, filled by putc/write and drained by uart_handler.
+// Producers mask IRQs around the push so the ring only ever sees one producer at a time.
+static uint8_t tx_buffer[UART_TX_BUFFER_SIZE];
+static struct ring tx_ring = RING_INIT(tx_buffer);
+__extension__ _Static_assert(RING_IS_POW2(UART_TX_BUFFER_SIZE), "UART_TX_BUFFER_SIZE must be a power of 2");
+
+// bytes received, uart_handler is the only producer and uart_read/getc consume
+static uint8_t rx_buffer[UART_RX_BUFFER_SIZE];
+static struct ring rx_ring = RING_INIT(rx_buffer);
+__extension__ _Static_assert(RING_IS_POW2(UART_RX_BUFFER_SIZE), "UART_RX_BUFFER_SIZE must be a power of 2");
+
+// readers and the rx_callback (the tty line discipline) run here, out of the irq
+static void uart_rx_tasklet_fn(void* data);
+static struct tasklet uart_rx_tasklet = TASKLET_INIT(uart_rx_tasklet, uart_rx_tasklet_fn, NULL);
+
+// 0 until the irq is wired up (and again after a panic), output is polled while it's 0
+static volatile int tx_async = 0;
+
 void uart_init(void) {
     // Disable interrupts (IER)
     UART0->IER_DLH = 0x00;
@@ -35,14 +62,16 @@ void uart_init_interrupts(void) {
     // Configure line control (8N1)
     UART0->LCR = 0x03; // 8 bits, no parity, 1 stop bit
 
-    // Enable FIFOs
-    UART0->IIR_FCR = 0x01;
+    // Enable and reset the FIFOs, set the rx trigger level
+    UART0->IIR_FCR = UART_FCR_SETUP;
 
-    // Enable receive interrupts
+    // Enable receive interrupts, THR empty only gets enabled while there's something to send
     UART0->IER_DLH = UART_IER_RX_INT;
 
     interrupt_controller.register_irq(1, uart_handler, NULL);
     interrupt_controller.enable_irq(1);
+
+    tx_async = 1;
 }
 
 void uart_disable_interrupts(void) {
@@ -51,23 +80,155 @@ void uart_disable_interrupts(void) {
     // UART0->IER_DLH = 0;
 }
 
-void uart_putc(char c) {
+static void uart_putc_sync(char c) {
     // Wait until Transmit Holding Register is empty (LSR[5] = 1)
-    while (!(UART0->LSR & (1 << 5)));
+    while (!(UART0->LSR & UART_LSR_THRE));
     UART0->RBR_THR_DLL = c;
 }
 
+// move up to a FIFO's worth out of the ring, IRQs must be masked
+static void uart_tx_fill(void) {
+    uint32_t sent = 0;
+    uint8_t* slot;
+
+    // with the FIFO on, THRE means the whole TX FIFO is empty
+    if (!(UART0->LSR & UART_LSR_THRE)) return;
+
+    while (sent < UART_TX_FIFO_DEPTH) {
+        uint32_t n = ring_peek_batch(&tx_ring, UART_TX_FIFO_DEPTH - sent, (void**)&slot);
+        if (!n) break;
+        for (uint32_t i = 0; i < n; i++) UART0->RBR_THR_DLL = slot[i];
+        ring_release(&tx_ring, n);
+        sent += n;
+    }
+
+    // only ask for the THR empty irq while there's more to send
+    if (ring_empty(&tx_ring)) UART0->IER_DLH &= ~UART_IER_TX_INT;
+    else UART0->IER_DLH |= UART_IER_TX_INT;
+
+    if (sent) wake_up_all(&uart_driver.tx_wait);
+}
+
+// queue as much of buf as fits, returns how many bytes were taken
+int uart_write(const char* buf, uint32_t len) {
+    uint32_t queued = 0;
+    uint8_t* slot;
+
+    if (!tx_async) {
+        for (uint32_t i = 0; i < len; i++) uart_putc_sync(buf[i]);
+        return len;
+    }
+
+    uint32_t flags = local_irq_save();
+    while (queued < len) {
+        uint32_t n = ring_reserve_batch(&tx_ring, len - queued, (void**)&slot);
+        if (!n) break;
+        memcpy(slot, buf + queued, n);
+        ring_commit(&tx_ring, n);
+        queued += n;
+    }
+    // start sending right away if the transmitter is idle, the irq takes it from there
+    if (queued) uart_tx_fill();
+    local_irq_restore(flags);
+
+    return queued;
+}
+
+void uart_putc(char c) {
+    if (!tx_async) {
+        uart_putc_sync(c);
+        return;
+    }
+
+    uint32_t flags = local_irq_save();
+    // printk can't fail or sleep, so on a full ring push the oldest bytes out by hand
+    while (ring_full(&tx_ring)) {
+        while (!(UART0->LSR & UART_LSR_THRE));
+        uart_tx_fill();
+    }
+    ring_push(&tx_ring, &c);
+    uart_tx_fill();
+    local_irq_restore(flags);
+}
+
+// polled drain of whatever is queued, output stays polled from here on (for panics)
+void uart_flush_sync(void) {
+    uint8_t c;
+
+    tx_async = 0;
+    UART0->IER_DLH &= ~UART_IER_TX_INT;
+    while (!ring_pop(&tx_ring, &c)) uart_putc_sync(c);
+}
+
 char uart_getc(void) {
-    // Wait until Data Ready (LSR[0] = 1)
-    while (!(UART0->LSR & 1));
-    return UART0->RBR_THR_DLL;
+    uint8_t c;
+
+    // once rx irqs are on the byte may land in the ring instead, take whichever comes first
+    while (1) {
+        if (!ring_pop(&rx_ring, &c)) return c;
+        if (UART0->LSR & UART_LSR_DR) return UART0->RBR_THR_DLL;
+    }
+}
+
+// copy out up to len received bytes without waiting, returns how many were copied
+int uart_read(char* buf, uint32_t len) {
+    uint32_t copied = 0;
+    uint8_t* slot;
+
+    while (copied < len) {
+        uint32_t n = ring_peek_batch(&rx_ring, len - copied, (void**)&slot);
+        if (!n) break;
+        memcpy(buf + copied, slot, n);
+        ring_release(&rx_ring, n);
+        copied += n;
+    }
+
+    return copied;
+}
+
+// empty the whole rx FIFO into the ring
+static void uart_rx_drain(void) {
+    uint32_t lsr;
+
+    while ((lsr = UART0->LSR) & UART_LSR_DR) {
+        uint8_t c = UART0->RBR_THR_DLL;
+        if (lsr & UART_LSR_OE) uart_driver.rx_overruns++;
+        if (ring_push(&rx_ring, &c)) uart_driver.rx_dropped++;
+    }
+
+    if (!ring_empty(&rx_ring)) tasklet_schedule(&uart_rx_tasklet);
+}
+
+static void uart_rx_tasklet_fn(void* data) {
+    (void)data;
+    wake_up_all(&uart_driver.rx_wait);
+    if (uart_driver.rx_callback) uart_driver.rx_callback();
 }
 
-// simple handler for cubieboard
+// simple handler for cubieboard, services every pending source before returning
 void uart_handler(int irq, void *data) {
     (void)data;
-    char c = UART0->RBR_THR_DLL;  // Read the character (clears interrupt)
-    uart_driver.incoming_buffer[uart_driver.incoming_buffer_head++ % UART0_INCOMING_BUFFER_SIZE] = c;
+    uint32_t iir;
+
+    while ((iir = UART0->IIR_FCR & UART_IIR_ID_MASK) != UART_IIR_NO_INT) {
+        switch (iir) {
+            case UART_IIR_THR_EMPTY:
+                uart_tx_fill();
+                break;
+            case UART_IIR_RX_DATA:
+            case UART_IIR_RX_TIMEOUT:
+                uart_rx_drain();  // reading below the trigger level clears it
+                break;
+            case UART_IIR_RX_LINE:
+                // reading LSR clears it
+                if (UART0->LSR & UART_LSR_OE) uart_driver.rx_overruns++;
+                uart_rx_drain();
+                break;
+            default:
+                goto done;
+        }
+    }
+done:
     INTC->IRQ_PEND[0] = (irq << 1);
     // uart_putc(c); // echo the character for now
 }
@@ -77,11 +238,15 @@ void uart_handler(int irq, void *data) {
 uart_driver_t uart_driver = {
     .init = uart_init,
     .putc = uart_putc,
+    .write = uart_write,
+    .flush_sync = uart_flush_sync,
     .getc = uart_getc,
+    .read = uart_read,
     .enable_interrupts = uart_init_interrupts,
     .disable_interrupts = uart_disable_interrupts,
 
-    .incoming_buffer = {0},
-    .incoming_buffer_head = 0,
-    .incoming_buffer_tail = 0,
+    .rx_dropped = 0,
+    .rx_overruns = 0,
+    .rx_wait = WAIT_QUEUE_INIT(uart_driver.rx_wait),
+    .tx_wait = WAIT_QUEUE_INIT(uart_driver.tx_wait),
 };
@@ -21,5 +21,30 @@ typedef struct {
 
 // Interrupt Enable Register (IER) bits
 #define UART_IER_RX_INT 0x01  // Receive Data Available Interrupt
+#define UART_IER_TX_INT 0x02  // Transmit Holding Register Empty Interrupt
+
+// Interrupt Identification Register (IIR) bits
+#define UART_IIR_ID_MASK    0x0F
+#define UART_IIR_NO_INT     0x01
+#define UART_IIR_THR_EMPTY  0x02
+#define UART_IIR_RX_DATA    0x04
+#define UART_IIR_RX_LINE    0x06
+#define UART_IIR_RX_TIMEOUT 0x0C
+
+// FIFO Control Register (FCR) bits
+#define UART_FCR_FIFO_EN     0x01
+#define UART_FCR_RX_RESET    0x02
+#define UART_FCR_TX_RESET    0x04
+#define UART_FCR_RX_TRIG_1   0x00  // rx irq after 1 byte
+#define UART_FCR_RX_TRIG_4   0x40  // 1/4 full on the A10
+#define UART_FCR_RX_TRIG_8   0x80  // 1/2 full on the A10
+#define UART_FCR_RX_TRIG_14  0xC0  // 2 short of full on the A10
+
+// Line Status Register (LSR) bits
+#define UART_LSR_DR   0x01  // Data Ready
+#define UART_LSR_OE   0x02  // Overrun Error, the FIFO was full and a byte was lost
+#define UART_LSR_THRE 0x20  // Transmit Holding Register Empty
+
+#define UART_TX_FIFO_DEPTH 16  // 64 on the A10, the 16550 qemu emulates has 16
 
 #endif
@@ -42,6 +42,7 @@
             pkgs.qemu
             pkgs.bear
             pkgs.lrzsz
+            pkgs.lz4
           ];
 
           # Add seer if available (might not be on all platforms)
@@ -81,6 +81,9 @@ typedef enum {
     BINARY_TYPE_ELF32,
 } binary_type_t;
 
+// elf_binary_t flags
+#define ELF_BINARY_PINNED 0x1   // raw is never freed or moved (initramfs), pages can be mapped from it directly
+
 typedef struct {
     size_t size;
     uint8_t* raw;
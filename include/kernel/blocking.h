@@ -0,0 +1,28 @@
+#ifndef KERNEL_BLOCKING_H
+#define KERNEL_BLOCKING_H
+
+#include <stdint.h>
+#include <kernel/list.h>
+
+// A list of processes blocked on some object (a device buffer, a child, ...).
+// block_on() sleeps on the process's own kernel stack until someone wakes the queue, the
+// caller then rechecks whatever it was waiting for, e.g.
+//
+//     while (!ready) block_on(&wq);
+typedef struct wait_queue {
+    struct list_head procs;  // process_t.list
+} wait_queue_t;
+
+#define WAIT_QUEUE_INIT(wq) { .procs = LIST_HEAD_INIT((wq).procs) }
+
+void wait_queue_init(wait_queue_t* wq);
+
+// sleep on wq until woken. Check the wait condition and call this with IRQs masked,
+// or a wakeup can slip in between
+void block_on(wait_queue_t* wq);
+
+// make the oldest / every waiter runnable again, safe from IRQ context
+void wake_up_one(wait_queue_t* wq);
+void wake_up_all(wait_queue_t* wq);
+
+#endif // KERNEL_BLOCKING_H
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <kernel/mm.h>
+#include <kernel/boottime.h>
 
 extern void setup_stacks(void);
 
@@ -36,6 +37,15 @@ extern void setup_stacks(void);
 #endif
 
 #define KERNEL_PATH "/boot/kernel.bin"
+#define KERNEL_LZ4_PATH "/boot/kernel.lz4"   // preferred over KERNEL_PATH when present
+
+// the compressed kernel is read here first, then decompressed to KERNEL_ENTRY
+#define KERNEL_STAGING_ADDR (DRAM_BASE + 0x0C000000)
+#define KERNEL_MAX_SIZE 0x4000000  // matches the RAM region in kernel.ld
+#define INITRAMFS_PATH "/boot/initrd.cpio"
+
+// physical address the bootloader loads the initramfs to, the kernel keeps these pages reserved
+#define INITRAMFS_LOAD_ADDR (DRAM_BASE + 0x08000000)
 
 // temporary stack size
 #define STACK_CANARY_VALUE 0xDEADBEEF
@@ -68,6 +78,9 @@ typedef struct {
     uint32_t l1_table_size;
     uint32_t l2_table_base;
     uint32_t l2_table_size;
+    uint32_t initramfs_base;   // physical address of the initramfs archive, 0 if none was loaded
+    uint32_t initramfs_size;
+    uint64_t boot_stamps[BOOT_PHASE_LOADER_COUNT]; // end of each bootloader phase, in clock_timer ticks
 } bootloader_t;
 
 
@@ -80,31 +93,38 @@ typedef struct {
 uint32_t calculate_checksum(const void *data, size_t len);
 
 // TODO checksum, versioning, flags, other things
-#define JUMP_KERNEL(kernel) do {  \
+// kernel_sum is calculate_checksum() of the loaded image, the caller has it already when
+// the image came out of an LZ4 frame
+#define JUMP_KERNEL(kernel_len, kernel_sum, initramfs_addr, initramfs_len) do {  \
+    boot_stamp(BOOT_PHASE_LOADER_EXIT); \
     bootloader_t bootloader = {   \
         .magic = 0xFEEDFACE,      \
         .build_time = "Build: " BUILD_DATE,    \
         .kernel_version = "",                \
         \
-        .kernel_size = (kernel).file_size,\
+        .kernel_size = (kernel_len),\
         .kernel_entry = KERNEL_ENTRY, \
-        .kernel_checksum = calculate_checksum((void*)KERNEL_ENTRY, (kernel).file_size),       \
+        .kernel_checksum = (kernel_sum),       \
         .kernel_flags = 0,                  \
-        .kernel_end = DRAM_BASE + (kernel).file_size, \
+        .kernel_end = DRAM_BASE + (kernel_len), \
         .total_memory = DRAM_SIZE,          \
-        .reserved_memory = (kernel).file_size, \
+        .reserved_memory = (kernel_len), \
         .l1_table_base = (uint32_t)(uintptr_t)l1_page_table, \
         .l1_table_size = 0x4000, \
         .l2_table_base = (uint32_t)(uintptr_t)l2_tables, \
         .l2_table_size = 0x400000, \
+        .initramfs_base = (initramfs_addr), \
+        .initramfs_size = (initramfs_len), \
     };\
-    fat32_close(&kernel);\
+    for (int _i = 0; _i < BOOT_PHASE_LOADER_COUNT; _i++) bootloader.boot_stamps[_i] = boot_stamps[_i]; \
     printk("Kernel size: %d\n", bootloader.kernel_size); \
+    printk("Kernel checksum: %x\n", bootloader.kernel_checksum); \
     printk("Kernel entry: %p\n", bootloader.kernel_entry); \
     printk("Kernel end: %p\n", bootloader.kernel_end); \
     printk("Kernel flags %d\n", bootloader.kernel_flags); \
     printk("Total memory: %dM (%d)\n", bootloader.total_memory / (1024*1024), bootloader.total_memory); \
     printk("Reserved memory: %d\n", bootloader.reserved_memory); \
+    printk("Initramfs: %p (%d bytes)\n", bootloader.initramfs_base, bootloader.initramfs_size); \
     printk("Entering kernel \nFirst instructions: %p %p %p %p\n",\
         *(uint32_t*)bootloader.kernel_entry,          \
        (*(uint32_t*)(bootloader.kernel_entry + 4)),   \
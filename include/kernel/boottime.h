@@ -0,0 +1,43 @@
+#ifndef KERNEL_BOOTTIME_H
+#define KERNEL_BOOTTIME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Boot phases, each stamp marks the END of its phase. Both sides read the
+// same free running counter (started by the bootloader) so the stamps line up.
+enum boot_phase {
+    // bootloader
+    BOOT_PHASE_LOADER_START,
+    BOOT_PHASE_UART_INIT,
+    BOOT_PHASE_DRAM_INIT,
+    BOOT_PHASE_MMC_INIT,
+    BOOT_PHASE_FAT_MOUNT,
+    BOOT_PHASE_KERNEL_READ,
+    BOOT_PHASE_KERNEL_UNPACK,
+    BOOT_PHASE_INITRAMFS_READ,
+    BOOT_PHASE_LOADER_EXIT,
+    BOOT_PHASE_LOADER_COUNT,
+
+    // kernel
+    BOOT_PHASE_KERNEL_PAGES = BOOT_PHASE_LOADER_COUNT,
+    BOOT_PHASE_KERNEL_HARDWARE,
+    BOOT_PHASE_PAGE_ALLOCATOR,
+    BOOT_PHASE_KERNEL_HEAP,
+    BOOT_PHASE_VFS_INIT,
+    BOOT_PHASE_INIT_SPAWN,
+    BOOT_PHASE_COUNT
+};
+
+// ticks at the end of each phase, 0 if the phase never ran (e.g no initramfs)
+extern uint64_t boot_stamps[BOOT_PHASE_COUNT];
+
+void boot_stamp(enum boot_phase phase);
+
+// pick up the bootloader's stamps out of bootloader_info
+void boot_stamps_import(void);
+// render the phase table into buf, returns the length like snprintf
+int boot_stamps_format(char* buf, size_t size);
+void boot_stamps_print(void);
+
+#endif // KERNEL_BOOTTIME_H
@@ -28,5 +28,12 @@
 #define EAGAIN 11
 #define EIO 5
 #define EMFILE 24
+#define EROFS 30
+#define ENOTTY 25
+#define E2BIG 7
+#define EFAULT 14
+#define EACCES 13
+#define EOVERFLOW 75
+#define ENOSPC 28
 
 #endif // KERNEL_ERRNO_H
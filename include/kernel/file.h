@@ -1,7 +1,10 @@
 #ifndef KERNEL_FILE_H
 #define KERNEL_FILE_H
 
-#define MAX_FDS 32
+#include <stdint.h>
+
+#define FD_TABLE_INITIAL 16  // slots a process starts with, doubled whenever it runs out
+#define FD_MAX 1024          // per process cap, open() fails with EMFILE past this
 
 #define SEEK_SET 0
 #define SEEK_CUR 1
@@ -9,7 +12,39 @@
 
 // typedef size_t ino_t;
 
-/* Per–process file descriptor table entry */
+/* Per–process file descriptor table */
+struct file;
+
+// files[fd] is the open file, a set bit in open marks the fd as taken so the lowest free
+// one is a count-trailing-zeros away instead of a scan over files
+struct fd_table {
+    struct file** files;
+    uint32_t* open;      // one bit per slot
+    uint32_t size;       // slots
+    int count;           // fds in use
+};
+
+int fd_table_init(struct fd_table* t);
+int fd_table_clone(struct fd_table* t, const struct fd_table* parent); // shares the files
+void fd_table_release(struct fd_table* t);                            // closes everything
+
+int fd_install(struct fd_table* t, struct file* file);   // lowest free fd, or -EMFILE/-ENOMEM
+int fd_install_at(struct fd_table* t, int fd, struct file* file); // fd has to be free
+struct file* fd_lookup(const struct fd_table* t, int fd); // NULL if fd isn't open
+struct file* fd_remove(struct fd_table* t, int fd);       // frees the fd, the caller drops the file
+
+// posix_spawn style file actions, applied in order to the child's copy of the parent's
+// fd table. An array ends with SPAWN_FD_END
+#define SPAWN_FD_END   0
+#define SPAWN_FD_CLOSE 1  // close fd
+#define SPAWN_FD_DUP2  2  // fd becomes another reference to src, closing whatever was there
+#define SPAWN_FD_ACTIONS_MAX 16
+
+struct spawn_fd_action {
+    int action;
+    int fd;
+    int src;
+};
 
 
 // struct dirent {
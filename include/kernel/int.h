@@ -1,6 +1,8 @@
 #ifndef KERNEL_INT_H
 #define KERNEL_INT_H
 
+#include <stdint.h>
+
 
 static inline void disable_interrupts(void) {
     __asm__ volatile("cpsid i");
@@ -10,5 +12,16 @@ static inline void enable_interrupts(void) {
     __asm__ volatile("cpsie i");
 }
 
+// mask IRQs and hand back the old cpsr, nests properly unlike a bare disable/enable pair
+static inline uint32_t local_irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile("mrs %0, cpsr\n\tcpsid i" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void local_irq_restore(uint32_t flags) {
+    __asm__ volatile("msr cpsr_c, %0" : : "r"(flags) : "memory");
+}
+
 
 #endif // KERNEL_INT_H
@@ -7,11 +7,13 @@
 #define CONFIG_LOG_LEVEL DEBUG
 #define LOG_SYSCALL_LEVEL DEBUG // the level that the syscall log messages will be logged at
 
-#define LOG_MAX_MESSAGE_SIZE 256
-#define LOG_MAX_BUFFER_LENGTH 1024
+#define LOG_MAX_MESSAGE_SIZE 256   // formatted line, only built when the log is consumed
+#define LOG_MAX_BUFFER_LENGTH 256  // records, must be a power of 2
+#define LOG_MAX_ARGS 8             // 32-bit argument words per record, 64-bit values take 2
+#define LOG_STRING_POOL 40         // bytes per record for copies of %s args from outside the kernel image
 
-// try and consume the log buffer after this many ticks
-#define LOG_CONSUME_TICKS 64
+// records klogd formats before it checks whether something else wants the cpu
+#define LOG_DRAIN_BUDGET 8
 
 
 // enabled features
@@ -36,9 +38,32 @@ enum LOG_LEVEL {
 
 extern enum LOG_LEVEL current_log_level;
 
-#define LOG(level, fmt, ...) \
-  if (level >= CONFIG_LOG_LEVEL && level >= current_log_level) \
-    log_commit(level, __FILE__, __func__,  __LINE__, fmt, ##__VA_ARGS__)
+enum log_arg_kind {
+    LOG_ARG_WORD,
+    LOG_ARG_DWORD,
+    LOG_ARG_STRING,
+};
+
+#define LOG_SITE_UNPARSED 0xFF
+
+// one per LOG() call site. the argument layout is worked out from fmt the first time
+// the site fires, after that a LOG() is a timestamp and a handful of word copies
+struct log_site {
+    const char* file;
+    const char* func;
+    int line;
+    int level;
+    const char* fmt;
+    uint8_t nargs;
+    uint8_t kinds[LOG_MAX_ARGS];
+};
+
+#define LOG(level, fmt, ...) do { \
+    if (level >= CONFIG_LOG_LEVEL && level >= current_log_level) { \
+        static struct log_site _log_site = { __FILE__, __func__, __LINE__, level, fmt, LOG_SITE_UNPARSED, {0} }; \
+        log_commit(&_log_site, ##__VA_ARGS__); \
+    } \
+} while (0)
 
 
 #ifdef TRACE_SYSCALLS
@@ -48,8 +73,11 @@ extern enum LOG_LEVEL current_log_level;
 #define LOG_SYSCALL(sysc)
 #endif
 
-void log_commit(int level, const char* file, const char* func, int line, const char* fmt, ...);
+void log_commit(struct log_site* site, ...);
 void log_syscall_commit(uint32_t syscall);
-void log_consume(void);
+void log_consume(void);            // drain everything, boot and panic paths
+int log_drain(uint32_t budget);    // drain up to budget records, returns how many are left
+int log_pending(void);
+void klogd_init(void);             // start the kthread that drains the log from here on
 
 #endif
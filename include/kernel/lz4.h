@@ -0,0 +1,18 @@
+#ifndef KERNEL_LZ4_H
+#define KERNEL_LZ4_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LZ4_FRAME_MAGIC 0x184D2204
+
+// decompress an LZ4 frame (as written by the lz4 cli) from src into dst.
+// the content checksum is verified when the frame has one. If checksum isn't NULL it gets
+// calculate_checksum() of the output, which is free when the frame carries it anyway.
+// returns the decompressed size, or a negative errno on a bad frame or if dst is too small
+int lz4_frame_decompress(const void* src, size_t src_len, void* dst, size_t dst_cap, uint32_t* checksum);
+
+// decompress a single raw LZ4 block, returns the decompressed size or a negative errno
+int lz4_block_decompress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_cap);
+
+#endif // KERNEL_LZ4_H
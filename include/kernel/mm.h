@@ -14,7 +14,9 @@
 #define MEMORY_USER_CODE_BASE    0x00010000   // Keep user code start
 #define MEMORY_USER_DATA_BASE    0x00100000   // Keep user data start
 #define MEMORY_USER_HEAP_BASE    0x01000000   // Keep user heap start
+#define MEMORY_USER_MMAP_BASE    0x10000000   // anonymous mmap, first fit from here up to the stack
 #define MEMORY_USER_STACK_BASE   0x30000000   // Move stack below kernel
+#define USER_STACK_LIMIT         (1024 * 1024) // stack reservation below the top of the stack, guard page included
 #define KERNEL_DIVIDER           0x80000000   // Keep kernel and user space separate
 #define KERNEL_VIRTUAL_BASE      0x80000000   // Kernel virtual address space
 #define KERNEL_VIRTUAL_DRAM      0x80000000   // Kernel virtual address space
@@ -97,6 +97,9 @@
 #define TTBR0_BOUNDARY(n) (0xFFFFFFFF >> (n))
 #define TTBR1_BOUNDARY(n) (~TTBR0_BOUNDARY(n))
 
+/* L1 entries a process table actually uses, everything above the split goes through TTBR1 */
+#define USER_L1_ENTRIES (SECTION_INDEX(TTBR0_BOUNDARY(TTBCR_SPLIT_2GB)) + 1)
+
 // arm specific
 static inline void set_ttbr0(uint32_t val) {
     __asm__ volatile ("mcr p15, 0, %0, c2, c0, 0" : : "r" (val) : "memory");
@@ -299,6 +302,13 @@ typedef struct {
     // will unmap a page from l1_table, otherwise using kernel pages if is null.
     void (*unmap_page)(void* l1_table, void* vaddr);
 
+    // clear every user entry in a process l1_table and free the L2 tables behind them,
+    // the L1 itself is left for the caller to reuse or free. Stale TLB entries are the caller's problem
+    void (*free_user_tables)(uint32_t* l1_table);
+
+    // kernel address of the L2 entry for vaddr in a process l1_table, NULL if there's no L2 table yet
+    uint32_t* (*get_pte)(uint32_t* l1_table, void* vaddr);
+
     // get the physical address of a virtual address for the ttbr0 table.
     void* (*get_physical_address)(uint32_t* ttbr0, void* vaddr);
 
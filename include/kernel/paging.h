@@ -4,15 +4,19 @@
 #include <kernel/boot.h>
 
 #define PAGE_SIZE 4096
+#define PAGE_ALIGN(x) (((x) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+
+#define PAGE_ANON 0x01 // private to one user mapping at pte, the swap clock may take it
+
+struct mm;
 
 struct page {
     struct page *next;
     uint32_t flags;
     void* paddr;
-    uint32_t used;
-
-    // pointer to the page table entry
-    uint32_t* pte;
+    uint32_t refcount; // mappings of the page, fork shares read only pages
+    uint32_t* pte;     // PAGE_ANON: the one pte mapping it (kernel address) and whose it is
+    struct mm* mm;
 };
 
 struct page_allocator {
@@ -26,6 +30,13 @@ struct page_allocator {
 
 void* alloc_page(struct page_allocator *alloc);
 void free_page(struct page_allocator *alloc, void *ptr);
+
+// shared pages, alloc_page hands out a count of 1 and page_put frees on the last reference
+void page_get(struct page_allocator *alloc, void *ptr);
+void page_put(struct page_allocator *alloc, void *ptr);
+
+// descriptor of an allocatable page, NULL for reserved or bad addresses
+struct page* page_desc(struct page_allocator *alloc, void *ptr);
 typedef struct page_allocator page_allocator_t;
 extern page_allocator_t kpage_allocator;
 
@@ -36,4 +47,9 @@ void init_page_allocator(struct page_allocator *alloc);
 void* alloc_aligned_pages(struct page_allocator *alloc, size_t count);
 void free_aligned_pages(struct page_allocator *alloc, void *ptr, size_t count);
 uint32_t alloc_l1_table(struct page_allocator *alloc);
+
+// asm/page.S - NEON page helpers, kernel only (the bootloader has no NEON enabled)
+void neon_enable(void);
+void clear_page(void* page);
+void copy_page(void* dest, const void* src);
 #endif
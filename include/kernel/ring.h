@@ -0,0 +1,140 @@
+#ifndef KERNEL_RING_H
+#define KERNEL_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kernel/string.h>
+
+// Lock-free single producer / single consumer ring of fixed size elements.
+//
+// head and tail are free running counters, the slot is counter & mask, so the
+// capacity has to be a power of 2 and every slot is usable (no empty gap).
+// The producer only writes head and the consumer only writes tail, each side
+// publishes with a release store and reads the other with an acquire load.
+//
+// "Single producer" is per context: if an IRQ handler and a process can both
+// push, the process side must mask IRQs around reserve..commit.
+//
+// Reserve/peek hand out slots in place, so records can be filled or read
+// without a copy, and the batch versions return as many as are contiguous.
+
+struct ring {
+    uint32_t head;      // written by the producer
+    uint32_t tail;      // written by the consumer
+    uint32_t mask;      // capacity - 1
+    uint32_t elem_size;
+    uint8_t* data;
+};
+
+#define RING_IS_POW2(n) ((n) && !((n) & ((n) - 1)))
+
+// static initializer over an array, e.g. struct ring r = RING_INIT(slots);
+#define RING_INIT(array) { \
+    .head = 0, .tail = 0, \
+    .mask = (sizeof(array) / sizeof((array)[0])) - 1, \
+    .elem_size = sizeof((array)[0]), \
+    .data = (uint8_t*)(array), \
+}
+
+static inline void ring_init(struct ring* r, void* data, uint32_t elem_size, uint32_t count) {
+    r->head = 0;
+    r->tail = 0;
+    r->mask = count - 1;
+    r->elem_size = elem_size;
+    r->data = (uint8_t*)data;
+}
+
+static inline uint32_t ring_capacity(const struct ring* r) {
+    return r->mask + 1;
+}
+
+static inline void* ring_slot(const struct ring* r, uint32_t counter) {
+    return r->data + (counter & r->mask) * r->elem_size;
+}
+
+// number of elements waiting, either side may call it
+static inline uint32_t ring_count(const struct ring* r) {
+    uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
+
+static inline int ring_empty(const struct ring* r) {
+    return ring_count(r) == 0;
+}
+
+static inline int ring_full(const struct ring* r) {
+    return ring_count(r) == ring_capacity(r);
+}
+
+// producer side
+
+// up to `want` free slots that are contiguous in memory, *slot points at the first
+static inline uint32_t ring_reserve_batch(struct ring* r, uint32_t want, void** slot) {
+    uint32_t head = r->head;
+    uint32_t free = ring_capacity(r) - (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE));
+    uint32_t to_wrap = ring_capacity(r) - (head & r->mask);
+
+    if (want > free) want = free;
+    if (want > to_wrap) want = to_wrap;
+    *slot = ring_slot(r, head);
+    return want;
+}
+
+static inline void* ring_reserve(struct ring* r) {
+    void* slot;
+    return ring_reserve_batch(r, 1, &slot) ? slot : NULL;
+}
+
+// publish n reserved slots to the consumer
+static inline void ring_commit(struct ring* r, uint32_t n) {
+    __atomic_store_n(&r->head, r->head + n, __ATOMIC_RELEASE);
+}
+
+// copy one element in, 0 on success or -1 if full
+static inline int ring_push(struct ring* r, const void* elem) {
+    void* slot = ring_reserve(r);
+    if (!slot) return -1;
+
+    if (r->elem_size == 1) *(uint8_t*)slot = *(const uint8_t*)elem;
+    else memcpy(slot, elem, r->elem_size);
+    ring_commit(r, 1);
+    return 0;
+}
+
+// consumer side
+
+// up to `want` filled slots that are contiguous in memory, *slot points at the first
+static inline uint32_t ring_peek_batch(struct ring* r, uint32_t want, void** slot) {
+    uint32_t tail = r->tail;
+    uint32_t used = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - tail;
+    uint32_t to_wrap = ring_capacity(r) - (tail & r->mask);
+
+    if (want > used) want = used;
+    if (want > to_wrap) want = to_wrap;
+    *slot = ring_slot(r, tail);
+    return want;
+}
+
+static inline void* ring_peek(struct ring* r) {
+    void* slot;
+    return ring_peek_batch(r, 1, &slot) ? slot : NULL;
+}
+
+// hand n consumed slots back to the producer
+static inline void ring_release(struct ring* r, uint32_t n) {
+    __atomic_store_n(&r->tail, r->tail + n, __ATOMIC_RELEASE);
+}
+
+// copy one element out, 0 on success or -1 if empty
+static inline int ring_pop(struct ring* r, void* elem) {
+    void* slot = ring_peek(r);
+    if (!slot) return -1;
+
+    if (r->elem_size == 1) *(uint8_t*)elem = *(const uint8_t*)slot;
+    else memcpy(elem, slot, r->elem_size);
+    ring_release(r, 1);
+    return 0;
+}
+
+#endif // KERNEL_RING_H
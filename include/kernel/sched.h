@@ -3,27 +3,42 @@
 #include <kernel/vfs.h>
 #include <kernel/file.h>
 #include <kernel/list.h>
+#include <kernel/blocking.h>
+#include <kernel/vma.h>
 #include <elf32.h>
 
 #include <stdint.h>
 
-#define MAX_PROCESSES 128
 #define MAX_ASID 255  // ARMv7 supports 8-bit ASIDs (0-255)
+#define PID_HASH_SIZE 64 // buckets for get_process_by_pid, must be a power of 2
+#define INIT_PID 1       // orphans are handed to init
 #define NULL_PROCESS_FILE "/elf/null"
 #define INIT_PROCESS_FILE "/elf/init"
 
 /* Process state definitions */
 #define PROCESS_RUNNING  1
-#define PROCESS_KILLED   2
+#define PROCESS_KILLED   2 // zombie, only the process_t and exit status are left until waitpid
 #define PROCESS_READY    3
 #define PROCESS_BLOCKED  4
 #define PROCESS_SLEEPING 5
 #define PROCESS_UNINTERUPTABLE 6
 #define PROCESS_NONE     0
 
+/* process_t.flags */
+#define PROCESS_FLAG_KTHREAD 0x01 // kernel thread, no user image or page table of its own
+#define PROCESS_FLAG_ORPHAN  0x02 // adopted by init, reaped on exit unless init is waiting for it
+#define PROCESS_FLAG_WAITED  0x04 // the parent is blocked in waitpid on it, it has to stay a zombie
+#define PROCESS_FLAG_VFORK   0x08 // borrowing the parent's address space until exec or exit
+
+#define PROCESS_NAME_MAX 16
+
 /* Kernel ticks until scheduler force reschedules */
 #define SCHEDULER_PREEMPT_TICKS 2 // should be a power of 2 ideally for faster modulo
 
+/* Per process kernel stack, exceptions from userspace land on it (the boot stack is KERNEL_STACK_SIZE in boot.h) */
+#define KSTACK_PAGES 2
+#define KSTACK_SIZE (KSTACK_PAGES * PAGE_SIZE)
+
 struct cpu_regs {
     uint32_t r0;  // 0
     uint32_t r1;  // 4
@@ -44,41 +59,39 @@ struct cpu_regs {
     uint32_t pc;  // 64
 };
 
-enum process_page_type {
-    PROCESS_PAGE_CODE,
-    PROCESS_PAGE_DATA,
-    PROCESS_PAGE_STACK,
-    PROCESS_PAGE_HEAP,
-    PROCESS_PAGE_OTHER
+// user registers saved at the top of the process's kernel stack on every exception from
+// userspace. The order is what the entry code needs: stmia {r0-r14}^ then srsdb (pc, cpsr),
+// and ret_to_user undoes it with ldmia ^ and rfeia
+struct trapframe {
+    uint32_t r[13];  // r0-r12, r0 doubles as the syscall return value
+    uint32_t sp;     // user sp
+    uint32_t lr;     // user lr
+    uint32_t pc;     // where to resume
+    uint32_t cpsr;   // user cpsr
 };
 
-typedef struct process_page_ref {
-    struct list_head list;
-    struct process_page* page;
-} process_page_ref_t;
-
-typedef struct process_page {
-    void* vaddr;           // Virtual address of the page
-    void* paddr;           // Physical address of the page
-    uint32_t ref_count;    // Number of processes referencing this page
-    uint32_t flags;        // Page flags (read/write/execute etc)
-
-    enum process_page_type page_type;   // Type of page (code, data, stack etc)
-    // size_t size;           // Size of the page (all 4k for now)
-    // uint32_t last_access;  // Timestamp of last page access
-} process_page_t;
-
+// kernel side registers of a process that isn't running, saved and loaded by switch_to.
+// Only the callee saved ones, everything else is already on the kernel stack
+struct cpu_context {
+    uint32_t r4, r5, r6, r7, r8, r9, r10, r11;
+    uint32_t sp;
+    uint32_t lr;
+};
 
 typedef struct process_struct {
-    uint32_t* stack_top;
-    uint32_t* stack_base_paddr;
+    struct trapframe* trapframe;  // saved user registers, at the top of kstack
+    struct cpu_context context;   // kernel registers while switched out
+    uint8_t* kstack;              // KSTACK_SIZE bytes (kernel virtual)
     int32_t pid;
     int32_t ppid;
+    struct list_head pid_link;    // pid hash bucket
+    struct list_head all_link;    // every live process, for listings and reparenting
     uint32_t priority;
     uint32_t state;
+    uint32_t flags;
 
     uint64_t wake_ticks;   // sleep state wake time
-    struct list_head list; // for wait queue
+    struct list_head list; // run queue, sleep list or a wait queue, never more than one
     void* blocked_on;      // pointer to the object the process is blocked on
 
     // Memory management
@@ -88,21 +101,17 @@ typedef struct process_struct {
     uint32_t code_size;
     uint32_t code_entry;
 
-    struct list_head pages_head;
-    uint32_t num_pages;
+    struct mm mm;         // areas of the user address space
 
     // file management
-    vfs_file_t* fd_table[MAX_FDS];
-    int num_fds;
-
-    int forked; // 1 if forked, 0 if not -- DEBUG - remove later
+    struct fd_table files;
 
     uint32_t syscall_trace; // syscalls to trace (bitmask)
     int32_t exit_status;    // exit status of the process
 
-    struct process_struct* waiting_parent;
+    wait_queue_t child_wait;      // waitpid sleeps here until a child exits
     // debug info
-    char* process_name;            // Name or identifier for the process
+    char process_name[PROCESS_NAME_MAX]; // binary name, or the kthread name
     uint32_t creation_time;        // Process creation timestamp
     uint32_t last_schedule_time;   // Last time this process was scheduled
     uint32_t total_run_time;       // Total CPU time used
@@ -128,25 +137,85 @@ typedef struct {
 } scheduler_t;
 extern scheduler_t scheduler_driver;
 
+typedef int (*kthread_fn_t)(void* arg);
+
 // get the process by pid
 process_t* get_process_by_pid(int32_t pid);
 
+// load an ELF from the vfs, returns an ERR_PTR on failure
+binary_t* load_binary(const char* path);
+
+// done with a binary once it's been loaded into a process
+void free_binary(binary_t* bin);
+
 // this can create or fork a process, based on which parameter is non-NULL
 process_t* create_process(binary_t* bin, process_t* parent);
 
+// new child of parent built straight from bin, nothing of the parent's memory is copied.
+// files becomes its fd table, on failure the caller still owns it
+process_t* spawn_process(binary_t* bin, process_t* parent, struct fd_table* files);
+
+// child that runs on parent's page table until it calls exec or exit, the parent has to
+// stay off the cpu until then (wait on its child_wait for the flag to clear)
+process_t* vfork_process(process_t* parent);
+
 // swap the currently executing code in process with the code in bin, without destroying the process or it's members
 int swap_process(binary_t* bin, process_t* process);
 
 // specifically free only the memory pages of a process (for exec or for cleanup)
 void free_process_memory(process_t* p);
 
+// the address space p runs on, a vfork child is still on its parent's
+struct mm* process_mm(process_t* p);
+
+// drop the TLB entries of one address space, after unmapping from it
+void flush_asid(uint32_t asid);
+
+// free everything current_process owns and leave a zombie for the parent's waitpid,
+// children are handed to init
+void process_exit(int status) __attribute__ ((noreturn));
+
+// free a zombie for good, after waitpid collected the exit status
+void release_process(process_t* p);
+
+// put p on the run queue, it has to be off every other list (safe from IRQ context)
+void sched_make_ready(process_t* p);
+
+// start a kernel thread running fn(arg) on its own kernel stack, returns an ERR_PTR on failure.
+// It's scheduled like any process but never leaves SVC mode and borrows whatever page
+// table was last loaded, so it must not touch user memory. There's no preemption inside
+// the kernel, a kthread gives up the cpu by blocking, sleeping or calling cond_resched().
+// Returning from fn is the same as kthread_exit(ret)
+process_t* kthread_create(kthread_fn_t fn, void* arg, const char* name);
+void kthread_exit(int status) __attribute__ ((noreturn));
+
+// name shown in /dev/ps, takes the last component of a path
+void set_process_name(process_t* p, const char* path);
+
+// one line per live process into buf, returns the length like snprintf
+int sched_format_processes(char* buf, size_t size);
+
 // initialize the scheduler
 int scheduler_init(void);
 
-// run the scheduler and start the next process. This function should never return, so be mindful of the stack usage.
+// pick the next process and switch to it, returns once current_process runs again
+void schedule(void);
+
+// schedule() for callers that never run again (boot, exit, a killed process)
 void scheduler(void) __attribute__ ((noreturn));
 
-// call to jump to userspace, either back to current process or to a new process
-void __attribute__((noreturn)) userspace_return(void);
+// preemption point for long running syscalls, lets a pending tick in and reschedules if asked
+void cond_resched(void);
+
+void kernel_exit_work(void);  // deferred work, called on every return to userspace
+
+// save the kernel registers into prev and resume next (swtch.S)
+void switch_to(struct cpu_context* prev, struct cpu_context* next);
+
+// restore the trapframe at sp and drop to userspace (vectors.S), where new processes start
+void ret_to_user(void);
+
+// where a new kthread starts, calls r4(r5) then kthread_exit (swtch.S)
+void kthread_start(void);
 
 #endif // KERNEL_SCHED_H
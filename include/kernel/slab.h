@@ -0,0 +1,35 @@
+#ifndef KERNEL_SLAB_H
+#define KERNEL_SLAB_H
+
+#include <stdint.h>
+#include <kernel/list.h>
+
+// Fixed size object caches carved out of single pages. Each page (slab) starts with a
+// struct slab and holds as many objects as fit after it, so an object's slab is just its
+// address rounded down to the page. A slab that empties out goes back to the page
+// allocator unless it's the only free one the cache has, so idle memory shrinks again.
+struct kmem_cache {
+    const char* name;
+    uint32_t obj_size;        // rounded up to 8
+    struct list_head partial; // slabs with free objects
+    struct list_head full;
+    void* empty;              // one spare slab kept so a busy alloc/free pair doesn't churn pages
+    uint32_t in_use;          // objects handed out
+    uint32_t slabs;           // pages held, the spare included
+};
+
+#define KMEM_CACHE_INIT(cache, cache_name, type) { \
+    .name = (cache_name), \
+    .obj_size = (sizeof(type) + 7) & ~7u, \
+    .partial = LIST_HEAD_INIT((cache).partial), \
+    .full = LIST_HEAD_INIT((cache).full), \
+    .empty = NULL, \
+    .in_use = 0, \
+    .slabs = 0, \
+}
+
+// not zeroed, NULL when out of pages
+void* kmem_cache_alloc(struct kmem_cache* cache);
+void kmem_cache_free(struct kmem_cache* cache, void* obj);
+
+#endif // KERNEL_SLAB_H
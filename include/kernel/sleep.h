@@ -4,13 +4,10 @@
 #include <stdint.h>
 #include <kernel/sched.h>
 
-typedef struct sleep_queue {
-    process_t* procs[MAX_PROCESSES];
-    uint32_t count;
-} sleep_queue_t;
-
-extern sleep_queue_t sleep_queue;
+// put the current process to sleep until the clock reaches wake_ticks
+void sleep_until(uint64_t wake_ticks);
 
+// make every process whose wake time has passed runnable, called from schedule()
 void check_sleep_expiry(void);
 
 #endif
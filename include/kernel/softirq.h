@@ -0,0 +1,45 @@
+#ifndef KERNEL_SOFTIRQ_H
+#define KERNEL_SOFTIRQ_H
+
+#include <stdint.h>
+#include <kernel/list.h>
+
+// Bottom halves. An irq handler only does what the hardware needs right now (ack, move
+// bytes out of a FIFO) and raises a softirq for the rest. Pending softirqs run at the end
+// of handle_irq_c with IRQs back on, so a slow bottom half never holds off another irq.
+//
+// Softirqs never run inside a section that has IRQs masked, so local_irq_save() keeps
+// them out as well. They can't sleep, anything that might belongs in a workqueue.
+
+enum softirq_nr {
+    SOFTIRQ_TIMER,    // timer callbacks (the scheduler tick)
+    SOFTIRQ_TASKLET,  // tasklet_schedule()
+    NR_SOFTIRQS,
+};
+
+// times do_softirq goes round for softirqs raised while it was running, whatever is
+// still pending after that waits for the next irq exit (the heartbeat is at most 1ms off)
+#define SOFTIRQ_MAX_RESTART 4
+
+typedef void (*softirq_fn_t)(void);
+
+void open_softirq(enum softirq_nr nr, softirq_fn_t fn);
+void raise_softirq(enum softirq_nr nr);  // safe from any context
+
+// called with IRQs masked on the way out of an irq
+void irq_exit(void);
+
+// one off deferred calls from an irq handler. A tasklet is queued at most once however
+// often it's scheduled before it runs, and never runs twice at the same time
+struct tasklet {
+    struct list_head list;
+    void (*fn)(void* data);
+    void* data;
+    uint8_t scheduled;
+};
+
+#define TASKLET_INIT(t, func, arg) { .list = LIST_HEAD_INIT((t).list), .fn = (func), .data = (arg), .scheduled = 0 }
+
+void tasklet_schedule(struct tasklet* t);
+
+#endif // KERNEL_SOFTIRQ_H
@@ -2,6 +2,7 @@
 #define KERNEL_STRING_H
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
 
 char* strtok(char* str, const char* delimiters);
 unsigned int strlen(const char* str);
@@ -12,12 +13,19 @@ int toupper(int c);
 void* memset(void* ptr, int value, unsigned long num);
 int memcmp(const void* ptr1, const void* ptr2, unsigned long num);
 void* memcpy(void* dest, const void* src, unsigned long size);
+void* memmove(void* dest, const void* src, unsigned long size);
 int strcmp(const char* str1, const char* str2);
 int strncmp(const char* str1, const char* str2, unsigned int n);
 char* strcat(char* dest, const char* src);
 char* strncat(char* dest, const char* src, unsigned int n);
+
+// #define CONFIG_MEMBENCH  // time the mem* family at boot
+void membench(void); // membench.c
+
 // string.c
 int vsnprintf(char *buf, size_t size, const char *fmt, va_list args);
 int snprintf(char *buf, size_t size, const char *fmt, ...);
+// same conversions, arguments come packed as 32-bit words (64-bit ones as lo, hi)
+int snprintf_words(char *buf, size_t size, const char *fmt, const uint32_t* words, size_t nwords);
 
 #endif
@@ -0,0 +1,25 @@
+#ifndef KERNEL_SWAP_H
+#define KERNEL_SWAP_H
+
+#include <stdint.h>
+#include <kernel/fat32.h>
+
+// Page sized slots in a swap file on the FAT32 volume. The file is allocated once at mount
+// and its clusters are looked up then, after that pages go straight to the sectors behind
+// it without touching the FAT or the directory again.
+
+// open (or create and grow) the swap file, 0 on success. Without it nothing gets swapped
+int swap_init(fat32_fs_t* fs);
+
+// write the page at kernel address page to a free slot, returns the slot or -ENOSPC / -EIO
+int swap_out(const void* page);
+
+// read slot back into page, the slot stays allocated until swap_free
+int swap_in(uint32_t slot, void* page);
+
+void swap_free(uint32_t slot);
+
+// slots left, 0 when there's no swap file at all
+uint32_t swap_free_slots(void);
+
+#endif // KERNEL_SWAP_H
@@ -15,7 +15,7 @@ typedef union {
     syscall_fn_4 fn4;
 } syscall_fn;
 
-#define NR_SYSCALLS 16
+#define NR_SYSCALLS 22
 enum syscall_num {
     SYS_DEBUG         = 0,
     SYS_EXIT          = 1,
@@ -34,6 +34,12 @@ enum syscall_num {
     SYS_LSEEK         = 14,
     SYS_WAITPID       = 15,
     SYS_EXECVE        = 16,
+    SYS_IOCTL         = 17,
+    SYS_SPAWN         = 18,
+    SYS_VFORK         = 19,
+    SYS_BRK           = 20,
+    SYS_MMAP          = 21,
+    SYS_MUNMAP        = 22,
 };
 
 typedef struct syscall_entry {
@@ -20,6 +20,9 @@ typedef struct {
     // Init whatever is needed for the timers before any can be started.
     void (*init)(void);
 
+    // Start the free running tick counter only, no interrupts. Used by the bootloader for boot stamps
+    void (*start_counter)(void);
+
     // Start any timer with usec delay, then call the callback, and repeat every usec
     void (*start)(uint32_t usec, void (*callback)(void));
 
@@ -0,0 +1,25 @@
+#ifndef KERNEL_TTY_H
+#define KERNEL_TTY_H
+
+#include <stdint.h>
+
+// /dev/tty, a line discipline on top of the uart driver. In canonical mode input is
+// edited in the kernel (erase, kill, echo) and read() only returns whole lines.
+
+#define TTY_LINE_MAX     256   // longest line that can be edited, the rest is ignored
+#define TTY_INPUT_SIZE   1024  // finished lines (or raw bytes) waiting for read()
+
+// mode flags
+#define TTY_MODE_CANON   0x01  // line editing, read() returns a line at a time
+#define TTY_MODE_ECHO    0x02  // echo input back to the terminal
+#define TTY_MODE_DEFAULT (TTY_MODE_CANON | TTY_MODE_ECHO)
+
+// control characters handled in canonical mode
+#define TTY_CHAR_ERASE   0x7F  // DEL, '\b' works too
+#define TTY_CHAR_KILL    0x15  // ^U, drop the whole line
+
+// ioctl commands
+#define TTY_IOCTL_GET_MODE 0x5401  // returns the mode flags
+#define TTY_IOCTL_SET_MODE 0x5402  // arg = new mode flags
+
+#endif // KERNEL_TTY_H
@@ -2,25 +2,27 @@
 #define DRIVERS_UART_H
 
 #include <stdint.h>
-#include <kernel/sched.h>
-
-#define UART0_INCOMING_BUFFER_SIZE 256
+#include <kernel/blocking.h>
 
 
 typedef struct {
     // TODO support multiple UARTs, qemu only has one
     void (*init)(void);
     void (*putc)(char c);
+    int (*write)(const char* buf, uint32_t len); // queue without blocking, returns bytes taken (optional)
+    void (*flush_sync)(void);                    // drain queued output polled and stay polled (optional)
     char (*getc)(void);
+    int (*read)(char* buf, uint32_t len);        // take buffered rx bytes without waiting (optional)
     void (*enable_interrupts)(void);
     void (*set_interrupt_handler)(void (*handler)(void));
     void (*disable_interrupts)(void);
 
-    char incoming_buffer[UART0_INCOMING_BUFFER_SIZE];
-    uint32_t incoming_buffer_head;
-    uint32_t incoming_buffer_tail;
+    uint32_t rx_dropped;   // bytes lost because the rx ring was full
+    uint32_t rx_overruns;  // times the hardware FIFO overflowed before we drained it
 
-    process_t* wait_queue;
+    wait_queue_t rx_wait;  // readers blocked until a byte arrives
+    wait_queue_t tx_wait;  // writers blocked until the tx ring has room
+    void (*rx_callback)(void); // run from the rx tasklet once new bytes are buffered (tty hooks in here)
 } uart_driver_t;
 
 extern uart_driver_t uart_driver;
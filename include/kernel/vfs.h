@@ -70,11 +70,12 @@ typedef struct file {
 } vfs_file_t;
 
 typedef vfs_file_t* (*open_fn)(vfs_dentry_t*, int flags);
-typedef int (*close_fn)(int fd);
+typedef int (*close_fn)(vfs_file_t*);  // last reference is gone, free whatever open hung off the file
 typedef ssize_t (*read_fn)(vfs_file_t*, void*, size_t);
 typedef ssize_t (*write_fn)(vfs_file_t*, const void*, size_t);
 typedef int (*readdir_fn)(vfs_file_t*, dirent_t*, size_t); // size_t should be the BUFFER SIZE (bytes) NOT number of entries
 typedef vfs_dentry_t* (*lookup_fn)(vfs_dentry_t*, const char* name);
+typedef int (*ioctl_fn)(vfs_file_t*, uint32_t cmd, uint32_t arg);
 
 // File operations structure
 typedef struct vfs_ops {
@@ -84,6 +85,7 @@ typedef struct vfs_ops {
     write_fn write;
     readdir_fn readdir;
     lookup_fn lookup;
+    ioctl_fn ioctl;     // device specific control, NULL gives -ENOTTY
 } vfs_ops_t;
 
 // File system operations
@@ -130,6 +132,9 @@ typedef struct device_ops {
 #define S_ISDIR(node) (((node)->mode & VFS_DIR) == VFS_DIR)
 #define S_ISREG(node) (((node)->mode & VFS_REG) == VFS_REG)
 
+// inode flags
+#define VFS_INODE_RAM 0x1   // file contents live in kernel memory at private_data (initramfs)
+
 // use all linux flags lol
 /* Owner permissions */
 #define S_IRUSR  0400    /* Read permission for owner */
@@ -155,6 +160,7 @@ typedef struct device_ops {
 #define S_ISVTX  01000   /* Sticky bit (restricted deletion flag) */
 
 extern vfs_dentry_t* vfs_root_node;
+extern vfs_ops_t vfs_ops;
 
 // FAT32 filesystem
 extern filesystem_type_t fat32_filesystem_type;
@@ -168,13 +174,22 @@ vfs_file_t* vfs_open(const char* path, int flags);
 
 // vfs_file_t* new_vfs_default_open(vfs_dentry_t* entry, int flags);
 vfs_file_t* vfs_default_open(vfs_dentry_t* entry, int flags);
-int vfs_default_close(int fd);
+int vfs_default_close(vfs_file_t* file);
+void vfs_file_put(vfs_file_t* file);
 vfs_dentry_t* vfs_finddir(const char* path);
+vfs_dentry_t* vfs_find_child(vfs_dentry_t* dir, const char* name);
+vfs_dentry_t* vfs_create_dirent(const char* name, uint32_t mode);
+int vfs_add_child(vfs_dentry_t* parent, vfs_dentry_t* child);
 
 // temp - these should be all one mega init vfs hardware function
 int zero_device_init(void);
 int ones_device_init(void);
 int uart0_vfs_device_init(void);
+ssize_t uart0_write(vfs_file_t* file, const void* buffer, size_t count);
+int tty_device_init(void);
 void init_mount_fat32(void);
+int initramfs_init(void);
+int boottime_device_init(void);
+int ps_device_init(void);
 
 #endif // KERNEL_VFS_H
@@ -0,0 +1,127 @@
+#ifndef KERNEL_VMA_H
+#define KERNEL_VMA_H
+
+#include <stdint.h>
+#include <kernel/list.h>
+#include <kernel/paging.h>
+
+// A process address space is a handful of areas (code, data, heap, stack), each a page
+// aligned range with one set of mapping flags. What's actually mapped lives in the page
+// tables and the per page refcount in struct page, so there's no per page bookkeeping here.
+// Areas sit on a sorted list for walking them and in a balanced tree for finding them
+// (vma_tree.c), so lookups and the search for a free gap stay O(log areas) however much a
+// process maps. The last hit is cached on top, which covers repeated lookups in one area.
+
+enum vma_type {
+    VMA_CODE,
+    VMA_DATA,
+    VMA_HEAP,
+    VMA_STACK,
+    VMA_MMAP,
+};
+
+#define VMA_WRITE   0x01 // private copy per process, copied on fork
+#define VMA_PINNED  0x02 // backed by kernel memory we don't own (initramfs), never freed
+#define VMA_GROWSDOWN 0x04 // stack, faults just below it extend it down to mm->stack_limit
+
+// mmap, same values as everyone else uses. Only private anonymous mappings for now
+#define PROT_READ     0x1
+#define PROT_WRITE    0x2
+#define PROT_EXEC     0x4
+#define MAP_SHARED    0x01
+#define MAP_PRIVATE   0x02
+#define MAP_FIXED     0x10
+#define MAP_ANONYMOUS 0x20
+
+struct vm_area {
+    struct list_head list;  // mm->vmas, sorted by start
+    uint32_t start;         // page aligned
+    uint32_t end;           // exclusive, page aligned
+    uint32_t prot;          // L2 descriptor flags for every page in the area
+    uint16_t type;          // enum vma_type
+    uint16_t flags;         // VMA_*
+    uint32_t backing;       // physical address of start for pinned areas
+
+    // mm->tree, see vma_tree.c
+    struct vm_area* parent;
+    struct vm_area* left;
+    struct vm_area* right;
+    uint32_t height;
+    uint32_t gap;           // free space right below this area
+    uint32_t max_gap;       // largest gap in this subtree
+};
+
+struct mm {
+    struct list_head vmas;
+    struct vm_area* tree;
+    struct vm_area* cache;  // last find_vma hit
+    uint32_t num_vmas;
+    uint32_t rss;           // pages mapped, shared ones included
+    uint32_t start_brk;     // the heap area runs from here to brk rounded up to a page
+    uint32_t brk;
+    uint32_t stack_limit;   // how far a VMA_GROWSDOWN area may reach below its end, guard page included
+};
+
+void mm_init(struct mm* mm);
+
+// area containing addr, or NULL
+struct vm_area* find_vma(struct mm* mm, uint32_t addr);
+
+// new empty area over [start, end), ERR_PTR(-EEXIST) if it overlaps one that's there already
+struct vm_area* vma_create(struct mm* mm, uint32_t start, uint32_t end, uint32_t prot, enum vma_type type, uint32_t flags);
+
+// back one page of vma with a zeroed page and map it, returns the page's kernel address
+void* vma_alloc_page(struct mm* mm, uint32_t* ttbr0, struct vm_area* vma, uint32_t vaddr);
+
+// map every page of vma now, from backing for pinned areas, zeroed pages otherwise
+int vma_populate(struct mm* mm, uint32_t* ttbr0, struct vm_area* vma);
+
+// fork: same areas in dst, read only, pinned and zero pages shared, writable ones copied
+// (swapped ones straight from swap)
+int mm_clone(struct mm* dst, uint32_t* dst_ttbr0, struct mm* src, uint32_t* src_ttbr0);
+
+// [addr, addr + len) is covered by areas, the pages don't have to be there yet
+int vma_range_ok(struct mm* mm, uint32_t addr, uint32_t len);
+
+// bring in the page at addr after a translation fault (from swap if it was pushed out), or
+// give it a private page after a write hit the zero page. 0 if the access can be retried, -EOVERFLOW when it hit the guard
+// page below a stack
+int vma_fault(struct mm* mm, uint32_t* ttbr0, uint32_t addr, int write);
+
+// unmap [start, end), trimming or splitting the areas it cuts through. The caller flushes the TLB
+int vma_unmap(struct mm* mm, uint32_t* ttbr0, uint32_t start, uint32_t end);
+
+// move the break, the heap area follows it. Shrinking unmaps, so the caller flushes the TLB
+int mm_brk(struct mm* mm, uint32_t* ttbr0, uint32_t brk);
+
+// new anonymous area, at addr with MAP_FIXED (replacing whatever was there) or the first gap that fits
+struct vm_area* mm_mmap(struct mm* mm, uint32_t* ttbr0, uint32_t addr, uint32_t len, uint32_t prot, uint32_t flags);
+
+// push up to count anonymous pages out to swap, returns how many pages were freed
+uint32_t vma_reclaim(uint32_t count);
+
+// drop every page and area, the L2 tables are left for mmu_driver.free_user_tables
+void mm_release(struct mm* mm, uint32_t* ttbr0);
+
+// vma_tree.c, keeps mm->tree and mm->vmas in step. Anything that moves an area's start or
+// end calls vma_tree_resized afterwards, areas never move past their neighbours
+
+// area containing addr, or NULL
+struct vm_area* vma_tree_find(struct mm* mm, uint32_t addr);
+
+// lowest area that ends above addr, or NULL
+struct vm_area* vma_tree_above(struct mm* mm, uint32_t addr);
+
+// add vma, which mustn't overlap any area there already
+void vma_tree_link(struct mm* mm, struct vm_area* vma);
+void vma_tree_unlink(struct mm* mm, struct vm_area* vma);
+void vma_tree_resized(struct mm* mm, struct vm_area* vma);
+
+// lowest address in [lo, hi) with len free bytes above it, 0 if there's no such gap
+uint32_t vma_tree_gap(struct mm* mm, uint32_t len, uint32_t lo, uint32_t hi);
+
+static inline uint32_t vma_pages(const struct vm_area* vma) {
+    return (vma->end - vma->start) / PAGE_SIZE;
+}
+
+#endif // KERNEL_VMA_H
@@ -0,0 +1,23 @@
+#ifndef KERNEL_WORKQUEUE_H
+#define KERNEL_WORKQUEUE_H
+
+#include <stdint.h>
+#include <kernel/list.h>
+
+// Deferred work that runs in the kworker kthread, so unlike a tasklet it may block,
+// sleep or take as long as it likes. Queue it from anywhere, irq handlers included.
+struct work {
+    struct list_head list;
+    void (*fn)(struct work* work);  // container_of to get at the surrounding struct
+    uint8_t pending;
+};
+
+#define WORK_INIT(w, func) { .list = LIST_HEAD_INIT((w).list), .fn = (func), .pending = 0 }
+
+// queue work unless it's already waiting, returns 0 if it was already queued
+int schedule_work(struct work* work);
+
+// start the kworker thread, work queued before this runs once it's up
+void workqueue_init(void);
+
+#endif // KERNEL_WORKQUEUE_H
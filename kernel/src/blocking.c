@@ -1,21 +1,41 @@
+#include <kernel/blocking.h>
 #include <kernel/sched.h>
+#include <kernel/int.h>
 
+void wait_queue_init(wait_queue_t* wq) {
+    INIT_LIST_HEAD(&wq->procs);
+}
+
+void block_on(wait_queue_t* wq) {
+    uint32_t flags = local_irq_save();
+
+    current_process->state = PROCESS_BLOCKED;
+    current_process->blocked_on = wq;
+    list_add_tail(&current_process->list, &wq->procs);
+    schedule(); // back once woken and picked again
+
+    local_irq_restore(flags);
+}
 
-typedef struct blocked_queue {
-    struct pcb* procs[MAX_PROCESSES];
-    uint32_t count;
-} blocked_queue_t;
+static void wake_process(process_t* p) {
+    list_del(&p->list);
+    p->blocked_on = NULL;
+    sched_make_ready(p);
+    scheduler_driver.schedule_next = 1; // get it running soon, not at the next preempt tick
+}
 
-blocked_queue_t blocked_queue;
+void wake_up_one(wait_queue_t* wq) {
+    uint32_t flags = local_irq_save();
+    if (!list_empty(&wq->procs)) {
+        wake_process(list_entry(wq->procs.next, process_t, list));
+    }
+    local_irq_restore(flags);
+}
 
-// wake up the first process that is blocked on an event
-void check_blocked_events(void) {
-    for (uint32_t i = 0; i < blocked_queue.count; ) {
-//         if (event_occurred(blocked_queue.procs[i]->wait_event)) {
-//             wake_process(blocked_queue.procs[i]);
-//             remove_from_blocked_queue(i);
-        // } else {
-            // i++;
-        // }
+void wake_up_all(wait_queue_t* wq) {
+    uint32_t flags = local_irq_save();
+    while (!list_empty(&wq->procs)) {
+        wake_process(list_entry(wq->procs.next, process_t, list));
     }
+    local_irq_restore(flags);
 }
@@ -0,0 +1,62 @@
+// boot phase timestamps, shared by the bootloader and the kernel
+#include <kernel/boottime.h>
+#include <kernel/timer.h>
+#include <kernel/boot.h>
+#include <kernel/printk.h>
+#include <kernel/string.h>
+
+uint64_t boot_stamps[BOOT_PHASE_COUNT];
+
+void boot_stamp(enum boot_phase phase) {
+    uint64_t ticks = clock_timer.get_ticks();
+    boot_stamps[phase] = ticks ? ticks : 1; // 0 means the phase never ran
+}
+
+static const char* boot_phase_names[BOOT_PHASE_COUNT] = {
+    [BOOT_PHASE_LOADER_START]   = "loader start",
+    [BOOT_PHASE_UART_INIT]      = "uart init",
+    [BOOT_PHASE_DRAM_INIT]      = "ccm/dram init",
+    [BOOT_PHASE_MMC_INIT]       = "mmc init",
+    [BOOT_PHASE_FAT_MOUNT]      = "fat mount",
+    [BOOT_PHASE_KERNEL_READ]    = "kernel read",
+    [BOOT_PHASE_KERNEL_UNPACK]  = "kernel unpack",
+    [BOOT_PHASE_INITRAMFS_READ] = "initramfs read",
+    [BOOT_PHASE_LOADER_EXIT]    = "loader exit",
+    [BOOT_PHASE_KERNEL_PAGES]   = "init_kernel_pages",
+    [BOOT_PHASE_KERNEL_HARDWARE] = "kernel hardware",
+    [BOOT_PHASE_PAGE_ALLOCATOR] = "init_page_allocator",
+    [BOOT_PHASE_KERNEL_HEAP]    = "kernel_heap_init",
+    [BOOT_PHASE_VFS_INIT]       = "vfs_init",
+    [BOOT_PHASE_INIT_SPAWN]     = "init spawn",
+};
+
+void boot_stamps_import(void) {
+    for (int i = 0; i < BOOT_PHASE_LOADER_COUNT; i++) {
+        boot_stamps[i] = bootloader_info.boot_stamps[i];
+    }
+}
+
+int boot_stamps_format(char* buf, size_t size) {
+    int len = snprintf(buf, size, "%-20s %10s %10s\n", "phase", "end (us)", "took (us)");
+    uint64_t prev = 0;
+
+    for (int i = 0; i < BOOT_PHASE_COUNT && len < (int)size - 1; i++) {
+        if (!boot_stamps[i]) {
+            // phase was skipped, or the platform can't time it
+            len += snprintf(buf + len, size - len, "%-20s %10s %10s\n", boot_phase_names[i], "-", "-");
+            continue;
+        }
+        uint32_t end = clock_timer.ticks_to_us(boot_stamps[i]);
+        uint32_t took = prev ? clock_timer.ticks_to_us(boot_stamps[i] - prev) : 0;
+        len += snprintf(buf + len, size - len, "%-20s %10u %10u\n", boot_phase_names[i], end, took);
+        prev = boot_stamps[i];
+    }
+
+    return len;
+}
+
+void boot_stamps_print(void) {
+    char buf[1024];
+    boot_stamps_format(buf, sizeof(buf));
+    printk("Boot timeline:\n%s", buf);
+}
@@ -7,13 +7,15 @@
 #include <kernel/paging.h>
 #include <kernel/mmu.h>
 #include <kernel/string.h>
+#include <kernel/panic.h>
+#include <kernel/int.h>
 
 
 uint32_t kernel_heap_start = KHEAP_START;
 uint32_t kernel_heap_end   = KHEAP_START + KHEAP_SIZE;
 uint32_t kernel_heap_curr  = KHEAP_START;
 
-static uint32_t kernel_heap_usage = 0;
+static uint32_t kernel_heap_usage = 0; // bytes handed out and not freed yet
 
 int kernel_heap_init(void) {
     for (uint32_t addr = kernel_heap_start; addr < kernel_heap_end; addr += PAGE_SIZE) {
@@ -47,24 +49,115 @@ void* simple_block_alloc(uint32_t size) {
     void* block = (void*)kernel_heap_curr;
     kernel_heap_curr = new_heap;
 
-    kernel_heap_usage += size;
-
     return block;
 }
 
-// returns a 4 byte aligned address in the heap
+// Every block has a header in front of it. Small requests are rounded up to a power of 2
+// class and go back on that class's free list when freed, bigger ones keep their size and
+// are reused first fit (no splitting). Nothing goes back to the bump region, but once
+// processes are coming and going at a steady rate the heap stops growing.
+#define KMALLOC_MIN_SHIFT 4   // 16 byte smallest class
+#define KMALLOC_CLASSES 8     // 16 .. 2048
+#define KMALLOC_MAX_SMALL (1u << (KMALLOC_MIN_SHIFT + KMALLOC_CLASSES - 1))
+
+#define KMALLOC_MAGIC_USED 0x6B6D5553
+#define KMALLOC_MAGIC_FREE 0x6B6D4652
+
+struct kmalloc_header {
+    uint32_t size;   // usable bytes, the class size for small blocks
+    uint32_t magic;  // catches double frees and frees of pointers kmalloc never handed out
+};
+
+struct kmalloc_free {
+    struct kmalloc_free* next;
+};
+
+static struct kmalloc_free* kmalloc_free_lists[KMALLOC_CLASSES];
+static struct kmalloc_free* kmalloc_large_free;
+
+static inline struct kmalloc_header* kmalloc_header_of(void* ptr) {
+    return (struct kmalloc_header*)ptr - 1;
+}
+
+static inline int kmalloc_class(uint32_t size) {
+    int cls = 0;
+    while ((1u << (cls + KMALLOC_MIN_SHIFT)) < size) cls++;
+    return cls;
+}
+
+static struct kmalloc_free* kmalloc_take_large(uint32_t size) {
+    struct kmalloc_free** link = &kmalloc_large_free;
+
+    while (*link) {
+        struct kmalloc_free* block = *link;
+        if (kmalloc_header_of(block)->size >= size) {
+            *link = block->next;
+            return block;
+        }
+        link = &block->next;
+    }
+    return NULL;
+}
+
+// returns an 8 byte aligned address in the heap
 void* kmalloc(uint32_t size) {
-    // Round up size to multiple of 4 bytes
-    size = (size + 3) & ~3;
+    struct kmalloc_header* header;
+    struct kmalloc_free* block;
+    uint32_t flags = local_irq_save();
+
+    if (size <= KMALLOC_MAX_SMALL) {
+        int cls = kmalloc_class(size);
+        size = 1u << (cls + KMALLOC_MIN_SHIFT);
+        block = kmalloc_free_lists[cls];
+        if (block) kmalloc_free_lists[cls] = block->next;
+    } else {
+        size = (size + 7) & ~7;
+        block = kmalloc_take_large(size);
+    }
+
+    if (block) {
+        // the bump heap always handed out zeroed memory and plenty of callers still count on it
+        header = kmalloc_header_of(block);
+        memset(block, 0, header->size);
+    } else {
+        header = simple_block_alloc(sizeof(*header) + size);
+        if (!header) {
+            local_irq_restore(flags);
+            return NULL;
+        }
+        header->size = size;
+    }
+
+    header->magic = KMALLOC_MAGIC_USED;
+    kernel_heap_usage += header->size;
+    local_irq_restore(flags);
 
-    // Ensure returned address is 4-byte aligned
-    void* ptr = simple_block_alloc(size);
-    return (void*)(((uintptr_t)ptr + 3) & ~3);
+    return header + 1;
 }
 
 void kfree(void* ptr) {
-    (void)ptr;
-    // Do nothing for now
+    if (!ptr) return;
+
+    struct kmalloc_header* header = kmalloc_header_of(ptr);
+    struct kmalloc_free* block = ptr;
+
+    if (header->magic != KMALLOC_MAGIC_USED) {
+        panic("kfree of %p that isn't an allocated block (magic %x)\n", ptr, header->magic);
+    }
+
+    uint32_t flags = local_irq_save();
+    header->magic = KMALLOC_MAGIC_FREE;
+    kernel_heap_usage -= header->size;
+
+    if (header->size <= KMALLOC_MAX_SMALL) {
+        int cls = kmalloc_class(header->size);
+        block->next = kmalloc_free_lists[cls];
+        kmalloc_free_lists[cls] = block;
+    } else {
+        block->next = kmalloc_large_free;
+        kmalloc_large_free = block;
+    }
+    local_irq_restore(flags);
 }
 
 char* strdup(const char* s) {
@@ -73,6 +166,5 @@ char* strdup(const char* s) {
     if (p) {
         memcpy(p, s, len);
     }
-    p[len] = '\0';
     return p;
 }
@@ -9,11 +9,16 @@
 
 #include <kernel/log.h>
 #include <kernel/time.h>
-#include <kernel/spinlock.h>
+#include <kernel/ring.h>
+#include <kernel/int.h>
+#include <kernel/blocking.h>
+#include <kernel/errno.h>
+#include <kernel/panic.h>
 #include <kernel/heap.h>
 #include <kernel/printk.h>
 #include <kernel/string.h>
 #include <kernel/timer.h>
+#include <kernel/mm.h>
 
 static const char* log_level_strings[] = {
     "[DEBUG]",
@@ -38,66 +43,51 @@ static const char* log_syscall_string = "[ SVC ]";
 // default log level for now dynamically is always DEBUG
 enum LOG_LEVEL current_log_level = DEBUG;
 
-struct log_msg {
-  uint64_t timestamp; // as TICKS
-  int level;
-  const char* file;
-  const char* func;
-  int line;
-  int32_t current_pid;
-  char message[LOG_MAX_MESSAGE_SIZE];
+enum log_record_kind {
+    LOG_RECORD_MESSAGE,
+    LOG_RECORD_SYSCALL,
 };
 
-// we can make this ring buffer generic later on, for now we only use it for logging
-struct ring_buffer {
-    struct log_msg buffer[LOG_MAX_BUFFER_LENGTH];
-    size_t head;               // Write position
-    size_t tail;               // Read position
-    spinlock_t lock;
+// what actually goes in the ring, nothing is formatted until log_consume.
+// %s args pointing into the kernel image are kept as pointers, anything else (stack
+// buffers, user memory, heap names) is copied into the record's string pool
+struct log_record {
+    uint64_t timestamp; // as TICKS
+    const struct log_site* site;
+    int16_t pid;
+    int16_t ppid;
+    uint8_t kind;
+    uint8_t nwords;
+    uint8_t pool_used;
+    uint32_t args[LOG_MAX_ARGS];
+    char pool[LOG_STRING_POOL];
 };
 
-static struct ring_buffer log_buffer;
-
-void ring_buffer_init(struct ring_buffer *rb) {
-    rb->head = 0;
-    rb->tail = 0;
-    spinlock_init(&rb->lock);
-}
-
-int ring_buffer_write(struct ring_buffer *rb, struct log_msg* data) {
-    spinlock_acquire(&rb->lock);
-
-    size_t next_head = (rb->head + 1) % LOG_MAX_BUFFER_LENGTH;
-    if (next_head == rb->tail) {
-        // Buffer is full (handle overflow or return false)
-        spinlock_release(&rb->lock);
-        return 1;
-    }
-
-    memcpy(&rb->buffer[rb->head], data, sizeof(struct log_msg));
-    rb->head = next_head;
-    spinlock_release(&rb->lock);
-    return 0;
-}
-
-int ring_buffer_read(struct ring_buffer *rb, struct log_msg* data) {
-    spinlock_acquire(&rb->lock);
-
-    if (rb->tail == rb->head) {
-        // Buffer is empty
-        spinlock_release(&rb->lock);
-        return 1;
+// producers are LOG() callers in any context, they mask IRQs around reserve..commit which
+// makes them a single producer as far as the ring is concerned. log_consume is the consumer
+__extension__ _Static_assert(RING_IS_POW2(LOG_MAX_BUFFER_LENGTH), "LOG_MAX_BUFFER_LENGTH must be a power of 2");
+static struct log_record log_records[LOG_MAX_BUFFER_LENGTH];
+static struct ring log_ring = RING_INIT(log_records);
+static uint32_t log_dropped;   // records lost to a full ring since the last consume
+static uint8_t log_consuming;  // only one context may drain at a time
+static wait_queue_t klogd_wait = WAIT_QUEUE_INIT(klogd_wait);
+
+// claim the next slot to fill in place, IRQs stay masked until log_record_commit
+static struct log_record* log_record_reserve(uint32_t* flags) {
+    *flags = local_irq_save();
+    struct log_record* rec = ring_reserve(&log_ring);
+    if (!rec) {
+        log_dropped++;
+        local_irq_restore(*flags);
     }
-
-    memcpy(data, &rb->buffer[rb->tail], sizeof(struct log_msg));
-
-    rb->tail = (rb->tail + 1) % LOG_MAX_BUFFER_LENGTH;
-    spinlock_release(&rb->lock);
-    return 0;
+    return rec;
 }
 
-int ring_buffer_empty(struct ring_buffer *rb) {
-    return rb->tail == rb->head;
+static void log_record_commit(uint32_t flags) {
+    ring_commit(&log_ring, 1);
+    // klogd only waits while the ring is empty, so this is one wakeup per burst
+    wake_up_one(&klogd_wait);
+    local_irq_restore(flags);
 }
 
 static inline void get_ascii_colour(enum LOG_LEVEL level, const char** colour, const char** reset) {
@@ -116,7 +106,7 @@ static inline void add_color_prefix(char** buf, const char* colour, size_t* rema
     *remaining -= written;
 }
 
-static inline void add_timestamp(struct log_msg* msg, char** buf, size_t* remaining) {
+static inline void add_timestamp(struct log_record* msg, char** buf, size_t* remaining) {
     #ifdef LOG_TIME
     int written = 0;
     uint64_t all_usec = clock_timer.ticks_to_us(msg->timestamp);
@@ -129,8 +119,8 @@ static inline void add_timestamp(struct log_msg* msg, char** buf, size_t* remain
     #endif
 }
 
-static inline void add_log_level(struct log_msg* msg, char** buf, size_t* remaining) {
-    int written = snprintf(*buf, *remaining, "%-7s", log_level_strings[msg->level]);
+static inline void add_log_level(const struct log_site* site, char** buf, size_t* remaining) {
+    int written = snprintf(*buf, *remaining, "%-7s", log_level_strings[site->level]);
     *buf += written;
     *remaining -= written;
 }
@@ -141,7 +131,7 @@ static inline void add_syscall_prefix(char** buf, size_t* remaining) {
     *remaining -= written;
 }
 
-static inline void add_fileline(struct log_msg* msg, char** buf, size_t* remaining) {
+static inline void add_fileline(const struct log_site* msg, char** buf, size_t* remaining) {
     // Add file and line information
     #if defined(LOG_FILE_NAME) || defined(LOG_LINE_NUM)
     int written = 0;
@@ -172,7 +162,7 @@ static inline void add_fileline(struct log_msg* msg, char** buf, size_t* remaini
     #endif
 }
 
-static inline void add_function(struct log_msg* msg, char** buf, size_t* remaining) {
+static inline void add_function(const struct log_site* msg, char** buf, size_t* remaining) {
     #ifdef LOG_FUNCTION_NAME
     int written = snprintf(*buf, *remaining, "[%s] ", msg->func);
     *buf += written;
@@ -180,8 +170,8 @@ static inline void add_function(struct log_msg* msg, char** buf, size_t* remaini
     #endif
 }
 
-static inline void add_user_message(char** buf, size_t* remaining, char* user_msg) {
-    int written = snprintf(*buf, *remaining, "%s", user_msg);
+static inline void add_user_message(struct log_record* msg, char** buf, size_t* remaining) {
+    int written = snprintf_words(*buf, *remaining, msg->site->fmt, msg->args, msg->nwords);
     *buf += written;
     *remaining -= written;
 }
@@ -198,28 +188,28 @@ static inline void add_newline(char** buf, size_t* remaining) {
     *remaining -= written;
 }
 
-static inline void add_current_pid(char** buf, size_t* remaining) {
+static inline void add_current_pid(struct log_record* msg, char** buf, size_t* remaining) {
     #ifdef LOG_PID
-    int written = snprintf(*buf, *remaining, "[PID: %d] ", current_process->pid);
+    int written = snprintf(*buf, *remaining, "[PID: %d] ", msg->pid);
     *buf += written;
     *remaining -= written;
     #endif
 }
 
-static inline void add_current_ppid(char** buf, size_t* remaining) {
+static inline void add_current_ppid(struct log_record* msg, char** buf, size_t* remaining) {
     #ifdef LOG_PPID
-    int written = snprintf(*buf, *remaining, "[PPID: %d] ", current_process->ppid);
+    int written = snprintf(*buf, *remaining, "[PPID: %d] ", msg->ppid);
     *buf += written;
     *remaining -= written;
     #endif
 }
 
-static inline void add_syscall_message(
-    char** buf,
-    size_t* remaining,
-    uint32_t syscall_num
-) {
+// args[0] is the syscall number, the rest are the raw register args
+static inline void add_syscall_message(struct log_record* msg, char** buf, size_t* remaining) {
     int written = 0;
+    uint32_t syscall_num = msg->args[0];
+    uint32_t* args = &msg->args[1];
+
     if(syscall_num > NR_SYSCALLS) {
         written = snprintf(*buf, *remaining, "[INVALID_SYSCALL:%d]", syscall_num);
         *buf += written;
@@ -227,78 +217,176 @@ static inline void add_syscall_message(
         return;
     }
 
-    uint32_t* user_stack = current_process->stack_top;
-
     switch (syscall_table[syscall_num].num_args) {
         case 0: written = snprintf(*buf, *remaining, "%s()", syscall_table[syscall_num].name); break;
-        case 1: written = snprintf(*buf, *remaining, "%s(%d)", syscall_table[syscall_num].name, user_stack[0]); break;
-        case 2: written = snprintf(*buf, *remaining, "%s(%d, %d)", syscall_table[syscall_num].name, user_stack[0], user_stack[1]); break;
-        case 3: written = snprintf(*buf, *remaining, "%s(%d, %d, %d)", syscall_table[syscall_num].name, user_stack[0], user_stack[1], user_stack[2]); break;
-        case 4: written = snprintf(*buf, *remaining, "%s(%d, %d, %d, %d)", syscall_table[syscall_num].name, user_stack[0], user_stack[1], user_stack[2], user_stack[3]); break;
+        case 1: written = snprintf(*buf, *remaining, "%s(%d)", syscall_table[syscall_num].name, args[0]); break;
+        case 2: written = snprintf(*buf, *remaining, "%s(%d, %d)", syscall_table[syscall_num].name, args[0], args[1]); break;
+        case 3: written = snprintf(*buf, *remaining, "%s(%d, %d, %d)", syscall_table[syscall_num].name, args[0], args[1], args[2]); break;
+        case 4: written = snprintf(*buf, *remaining, "%s(%d, %d, %d, %d)", syscall_table[syscall_num].name, args[0], args[1], args[2], args[3]); break;
     }
     *buf += written;
     *remaining -= written;
 }
 
-void format_log_message(
-    struct log_msg* msg,
-    const char* fmt,
-    va_list args
-) {
-    // format the raw message
-    char user_msg[LOG_MAX_MESSAGE_SIZE];
-    va_list args_copy;
-    va_copy(args_copy, args);
-    vsnprintf(user_msg, sizeof(user_msg), fmt, args_copy);
-    va_end(args_copy);
-
+// runs in log_consume, turn a record back into a line
+static void format_log_message(struct log_record* msg, char* line) {
+    const struct log_site* site = msg->site;
     const char* color, *reset;
-    get_ascii_colour(msg->level, &color, &reset);
+    get_ascii_colour(site->level, &color, &reset);
+
+    // copied strings were stored as offsets into the pool, point them back at it
+    for (int i = 0, word = 0; i < site->nargs && word < msg->nwords; i++) {
+        if (site->kinds[i] == LOG_ARG_STRING && msg->args[word] < LOG_STRING_POOL) {
+            msg->args[word] = (uint32_t)(uintptr_t)(msg->pool + msg->args[word]);
+        }
+        word += site->kinds[i] == LOG_ARG_DWORD ? 2 : 1;
+    }
 
     // Start building the formatted message
-    char *buf = msg->message;
+    char *buf = line;
     size_t remaining = LOG_MAX_MESSAGE_SIZE;
 
     add_color_prefix(&buf, color, &remaining);
-    add_log_level(msg, &buf, &remaining);
+    add_log_level(site, &buf, &remaining);
     add_timestamp(msg, &buf, &remaining);
-    add_fileline(msg, &buf, &remaining);
-    add_function(msg, &buf, &remaining);
-    add_user_message(&buf, &remaining, user_msg);
+    add_fileline(site, &buf, &remaining);
+    add_function(site, &buf, &remaining);
+    add_user_message(msg, &buf, &remaining);
     add_color_reset(&buf, reset, &remaining);
 
     // Ensure null-termination
-    msg->message[LOG_MAX_MESSAGE_SIZE - 1] = '\0';
+    line[LOG_MAX_MESSAGE_SIZE - 1] = '\0';
+}
+
+// walk fmt the same way vsnprintf does and note what each conversion takes off the stack
+static void log_parse_site(struct log_site* site) {
+    const char* p = site->fmt;
+    int nargs = 0, words = 0;
+
+    while (*p) {
+        if (*p++ != '%') continue;
+
+        while (*p == '-' || *p == '0') p++;
+        if (*p == '*') {
+            if (words + 1 > LOG_MAX_ARGS) break;
+            site->kinds[nargs++] = LOG_ARG_WORD;
+            words++;
+            p++;
+        }
+        while (*p >= '0' && *p <= '9') p++;
+
+        int length = 0;
+        while (*p == 'l') {
+            length++;
+            p++;
+        }
+
+        enum log_arg_kind kind;
+        switch (*p) {
+            case 'd': case 'i': case 'u': case 'x': case 'X':
+                kind = length >= 2 ? LOG_ARG_DWORD : LOG_ARG_WORD;
+                break;
+            case 'p': case 'c':
+                kind = LOG_ARG_WORD;
+                break;
+            case 's':
+                kind = LOG_ARG_STRING;
+                break;
+            default:
+                // %% and unknown conversions don't take an argument
+                if (*p) p++;
+                continue;
+        }
+        p++;
+
+        int size = kind == LOG_ARG_DWORD ? 2 : 1;
+        if (words + size > LOG_MAX_ARGS) break; // the rest print as 0
+        site->kinds[nargs++] = kind;
+        words += size;
+    }
+
+    site->nargs = nargs;
+}
+
+// strings in the kernel image (rodata) live forever, anything else could be gone by consume time
+static inline int log_string_is_static(const char* str) {
+    extern uint32_t kernel_code_end;
+    return (uintptr_t)str >= KERNEL_START && (uintptr_t)str < (uintptr_t)&kernel_code_end;
+}
+
+static uint32_t log_pool_string(struct log_record* rec, const char* str) {
+    if (!str) return (uint32_t)(uintptr_t)"(null)";
+    if (log_string_is_static(str)) return (uint32_t)(uintptr_t)str;
+
+    uint32_t offset = rec->pool_used;
+    uint32_t space = LOG_STRING_POOL - offset;
+    if (space < 2) return (uint32_t)(uintptr_t)"(...)";
+
+    uint32_t len = 0;
+    while (str[len] && len < space - 1) {
+        rec->pool[offset + len] = str[len];
+        len++;
+    }
+    rec->pool[offset + len] = '\0';
+    rec->pool_used += len + 1;
+    return offset;
+}
+
+static inline void log_record_header(struct log_record* rec, const struct log_site* site, uint8_t kind) {
+    rec->timestamp = clock_timer.get_ticks();
+    rec->site = site;
+    rec->kind = kind;
+    rec->pid = current_process ? current_process->pid : -1;
+    rec->ppid = current_process ? current_process->ppid : -1;
+    rec->pool_used = 0;
 }
 
+void log_commit(struct log_site* site, ...) {
+    if (site->nargs == LOG_SITE_UNPARSED) log_parse_site(site);
 
+    uint32_t flags;
+    struct log_record* rec = log_record_reserve(&flags);
+    if (!rec) return;
 
+    log_record_header(rec, site, LOG_RECORD_MESSAGE);
 
-void log_commit(int level, const char *file, const char *func, int line, const char *fmt, ...) {
     va_list args;
-    va_start(args, fmt);
-    struct log_msg msg;
-    msg.current_pid = current_process ? current_process->pid : -1;
-    msg.timestamp = clock_timer.get_ticks();
-    msg.level = level;
-    msg.file = file;
-    msg.line = line;
-    msg.func = func;
-
-    format_log_message(&msg, fmt, args);
+    va_start(args, site);
+    int word = 0;
+    for (int i = 0; i < site->nargs; i++) {
+        switch (site->kinds[i]) {
+            case LOG_ARG_WORD:
+                rec->args[word++] = va_arg(args, uint32_t);
+                break;
+            case LOG_ARG_DWORD: {
+                uint64_t value = va_arg(args, uint64_t);
+                rec->args[word++] = (uint32_t)value;
+                rec->args[word++] = (uint32_t)(value >> 32);
+                break;
+            }
+            case LOG_ARG_STRING:
+                rec->args[word++] = log_pool_string(rec, va_arg(args, const char*));
+                break;
+        }
+    }
     va_end(args);
+    rec->nwords = word;
 
-    ring_buffer_write(&log_buffer, &msg);
+    log_record_commit(flags);
 }
 
 
 // SYSCALL LOGGING
 
-void format_log_syscall_message(int syscall_num, struct log_msg* msg) {
-    char *buf = msg->message;
+static const struct log_site log_syscall_site = {
+    .file = "", .func = "", .line = 0, .level = LOG_SYSCALL_LEVEL, .fmt = "", .nargs = 0,
+};
+
+static void format_log_syscall_message(struct log_record* msg, char* line) {
+    char *buf = line;
     size_t remaining = LOG_MAX_MESSAGE_SIZE;
     const char* color, *reset;
-    get_ascii_colour(msg->level, &color, &reset);
+    get_ascii_colour(msg->site->level, &color, &reset);
 
     // start
     add_color_prefix(&buf, color, &remaining);
@@ -307,9 +395,9 @@ void format_log_syscall_message(int syscall_num, struct log_msg* msg) {
 
     // body
     add_timestamp(msg, &buf, &remaining);
-    add_current_pid(&buf, &remaining);
-    add_current_ppid(&buf, &remaining);
-    add_syscall_message(&buf, &remaining, syscall_num);
+    add_current_pid(msg, &buf, &remaining);
+    add_current_ppid(msg, &buf, &remaining);
+    add_syscall_message(msg, &buf, &remaining);
 
 
     // end
@@ -317,29 +405,78 @@ void format_log_syscall_message(int syscall_num, struct log_msg* msg) {
     add_newline(&buf, &remaining);
 
     // Ensure null-termination
-    msg->message[LOG_MAX_MESSAGE_SIZE - 1] = '\0';
+    line[LOG_MAX_MESSAGE_SIZE - 1] = '\0';
 }
 
 void log_syscall_commit(uint32_t syscall) {
-    struct log_msg msg;
-    msg.current_pid = current_process ? current_process->pid : -1;
-    msg.timestamp = clock_timer.get_ticks();
-    msg.level = LOG_SYSCALL_LEVEL;
-    msg.file = "";
-    msg.line = 0;
-    msg.func = "";
+    uint32_t flags;
+    struct log_record* rec = log_record_reserve(&flags);
+    if (!rec) return;
 
-    format_log_syscall_message(syscall, &msg);
+    log_record_header(rec, &log_syscall_site, LOG_RECORD_SYSCALL);
+    rec->args[0] = syscall;
+    for (int i = 0; i < 4; i++) rec->args[i + 1] = current_process->trapframe->r[i];
+    rec->nwords = 5;
 
-    ring_buffer_write(&log_buffer, &msg);
+    log_record_commit(flags);
 }
 
 
-void log_consume(void) {
-    while (!ring_buffer_empty(&log_buffer)) {
-        struct log_msg msg;
-        ring_buffer_read(&log_buffer, &msg);
+int log_pending(void) {
+    return !ring_empty(&log_ring);
+}
+
+int log_drain(uint32_t budget) {
+    struct log_record* rec;
+    char line[LOG_MAX_MESSAGE_SIZE];
+
+    // an IRQ landing while a process is draining would be a second consumer
+    if (__atomic_test_and_set(&log_consuming, __ATOMIC_ACQUIRE)) return ring_count(&log_ring);
+
+    while (budget-- && (rec = ring_peek(&log_ring))) {
+        if (rec->kind == LOG_RECORD_SYSCALL) {
+            format_log_syscall_message(rec, line);
+        } else {
+            format_log_message(rec, line);
+        }
+        // the slot is free as soon as it's formatted, don't hold it across the uart
+        ring_release(&log_ring, 1);
+
         // for now, just print the message over uart
-        printk("%s", msg.message);
+        printk("%s", line);
     }
+
+    uint32_t dropped = __atomic_exchange_n(&log_dropped, 0, __ATOMIC_RELAXED);
+    if (dropped) printk("[log] dropped %d messages, ring was full\n", dropped);
+
+    __atomic_clear(&log_consuming, __ATOMIC_RELEASE);
+    return ring_count(&log_ring);
+}
+
+void log_consume(void) {
+    // keep going until it's empty, unless another context is already draining
+    while (log_pending() && !__atomic_load_n(&log_consuming, __ATOMIC_RELAXED)) {
+        log_drain(LOG_MAX_BUFFER_LENGTH);
+    }
+}
+
+// formatting and the uart happen here instead of in whoever called LOG()
+static int klogd(void* arg) {
+    (void)arg;
+
+    while (1) {
+        uint32_t flags = local_irq_save();
+        while (!log_pending()) block_on(&klogd_wait);
+        local_irq_restore(flags);
+
+        log_drain(LOG_DRAIN_BUDGET);
+        cond_resched(); // a long burst shouldn't starve everything else
+    }
+
+    return 0;
+}
+
+void klogd_init(void) {
+    process_t* p = kthread_create(klogd, NULL, "klogd");
+    if (IS_ERR(p)) panic("Failed to start klogd (%d)\n", PTR_ERR(p));
 }
@@ -16,6 +16,8 @@
 #include <kernel/time.h>
 #include <kernel/rtc.h>
 #include <kernel/log.h>
+#include <kernel/boottime.h>
+#include <kernel/workqueue.h>
 #include <elf32.h>
 
 #include <stdint.h>
@@ -84,6 +86,9 @@ __attribute__((noreturn))void enter_userspace(void) {
     disable_interrupts();
     LOG(INFO, "Starting userspace\n");
     scheduler_init();
+    klogd_init();
+    workqueue_init();
+    boot_stamp(BOOT_PHASE_INIT_SPAWN);
     ticks = clock_timer.get_ticks();
     ms = clock_timer.ticks_to_ms(ticks);
     s = ms / 1000;
@@ -91,6 +96,7 @@ __attribute__((noreturn))void enter_userspace(void) {
     LOG(INFO, "Kernel ready after %u.%04u seconds!\n", s, ms);
     LOG(INFO, "Jumping to PID 0\n");
     log_consume(); // flush the log buffer
+    boot_stamps_print();
     enable_interrupts();
     scheduler();
 
@@ -102,12 +108,16 @@ __attribute__((noreturn))void enter_userspace(void) {
 __attribute__((section(".text.kernel_main"), noreturn))
 void kernel_main(bootloader_t* _bootloader_info) {
     setup_stacks();      // switches mode to SVC
+    neon_enable();       // for clear_page/copy_page
     init_kernel_pages();
 
     for (size_t i = 0; i < sizeof(bootloader_t); i++) ((char*)&bootloader_info)[i] = ((char*)_bootloader_info)[i]; // copy bootloader into memory controlled by the kernel
     if (bootloader_info.magic != 0xFEEDFACE) panic("Invalid bootloader magic: %x\n", bootloader_info.magic);
+    boot_stamps_import();
+    boot_stamp(BOOT_PHASE_KERNEL_PAGES); // devices are only mapped for the kernel from here on
     init_stack_canary();
     init_kernel_hardware(); // initialize the most basic hardware
+    boot_stamp(BOOT_PHASE_KERNEL_HARDWARE);
 
     LOG(INFO, "Kernel starting - version %s\n", GIT_VERSION);
     LOG(INFO, "Kernel base address %p\n", kernel_main);
@@ -115,10 +125,16 @@ void kernel_main(bootloader_t* _bootloader_info) {
 
     // kernel memory
     init_page_allocator(&kpage_allocator);
+    boot_stamp(BOOT_PHASE_PAGE_ALLOCATOR);
     kernel_heap_init();
+    boot_stamp(BOOT_PHASE_KERNEL_HEAP);
+#ifdef CONFIG_MEMBENCH
+    membench();
+#endif
     // setup dynamic managed stacks better
 
     vfs_init();
+    boot_stamp(BOOT_PHASE_VFS_INIT);
 
     // make the jump to starting the scheduler and starting our init process
     enter_userspace();
@@ -0,0 +1,83 @@
+// boot time throughput check for the mem* family, enable with CONFIG_MEMBENCH in string.h
+#include <kernel/string.h>
+
+#if defined(CONFIG_MEMBENCH) && !defined(BOOTLOADER)
+#include <kernel/printk.h>
+#include <kernel/paging.h>
+#include <kernel/timer.h>
+#include <kernel/mm.h>
+#include <kernel/int.h>
+
+#define MEMBENCH_BYTES (1024 * 1024) // per size class
+
+static const uint32_t membench_sizes[] = { 16, 64, 256, 1024, PAGE_SIZE };
+
+// the old one byte per iteration loops, as a baseline
+static void byte_set(uint8_t* d, int value, uint32_t n) {
+    while (n--) *d++ = (uint8_t)value;
+}
+
+static void byte_copy(uint8_t* d, const uint8_t* s, uint32_t n) {
+    while (n--) *d++ = *s++;
+}
+
+enum membench_op { OP_BYTE_SET, OP_MEMSET, OP_CLEAR_PAGE, OP_BYTE_COPY, OP_MEMCPY, OP_MEMCPY_UNALIGNED, OP_COPY_PAGE };
+
+static const char* membench_op_names[] = {
+    "byte set", "memset", "clear_page", "byte copy", "memcpy", "memcpy src+1", "copy_page"
+};
+
+// MB/s for one op at one size
+static uint32_t membench_run(enum membench_op op, uint8_t* dst, uint8_t* src, uint32_t size) {
+    uint32_t iterations = MEMBENCH_BYTES / size;
+    uint64_t start = clock_timer.get_ticks();
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        switch (op) {
+            case OP_BYTE_SET:         byte_set(dst, i, size); break;
+            case OP_MEMSET:           memset(dst, i, size); break;
+            case OP_CLEAR_PAGE:       clear_page(dst); break;
+            case OP_BYTE_COPY:        byte_copy(dst, src, size); break;
+            case OP_MEMCPY:           memcpy(dst, src, size); break;
+            case OP_MEMCPY_UNALIGNED: memcpy(dst, src + 1, size - 1); break;
+            case OP_COPY_PAGE:        copy_page(dst, src); break;
+        }
+    }
+
+    uint32_t us = clock_timer.ticks_to_us(clock_timer.get_ticks() - start);
+    return us ? MEMBENCH_BYTES / us : 0; // bytes per us == MB/s
+}
+
+void membench(void) {
+    uint8_t* dst = (uint8_t*)PHYS_TO_KERNEL_VIRT(alloc_page(&kpage_allocator));
+    uint8_t* src = (uint8_t*)PHYS_TO_KERNEL_VIRT(alloc_page(&kpage_allocator));
+    uint32_t nsizes = sizeof(membench_sizes) / sizeof(membench_sizes[0]);
+    char line[128];
+    int len;
+
+    for (uint32_t i = 0; i < PAGE_SIZE; i++) src[i] = i;
+
+    // printk doesn't pad, build each row with snprintf
+    len = snprintf(line, sizeof(line), "%-14s", "op");
+    for (uint32_t i = 0; i < nsizes; i++) {
+        len += snprintf(line + len, sizeof(line) - len, "%8u", membench_sizes[i]);
+    }
+    printk("membench: MB/s over %dKB per size\n%s\n", MEMBENCH_BYTES / 1024, line);
+
+    for (int op = OP_BYTE_SET; op <= OP_COPY_PAGE; op++) {
+        len = snprintf(line, sizeof(line), "%-14s", membench_op_names[op]);
+        for (uint32_t i = 0; i < nsizes; i++) {
+            int page_op = op == OP_CLEAR_PAGE || op == OP_COPY_PAGE;
+            if (page_op && membench_sizes[i] != PAGE_SIZE) {
+                len += snprintf(line + len, sizeof(line) - len, "%8s", "-");
+            } else {
+                len += snprintf(line + len, sizeof(line) - len, "%8u", membench_run(op, dst, src, membench_sizes[i]));
+            }
+        }
+        printk("%s\n", line);
+    }
+
+    free_page(&kpage_allocator, (void*)KERNEL_VIRT_TO_PHYS((uint32_t)dst));
+    free_page(&kpage_allocator, (void*)KERNEL_VIRT_TO_PHYS((uint32_t)src));
+}
+#endif
@@ -25,8 +25,18 @@ void init_page_allocator(struct page_allocator *alloc) {
     alloc->free_pages = alloc->total_pages - alloc->reserved_pages;
     alloc->free_list = NULL;
 
+    // the initramfs stays where the bootloader put it, files are served (and mapped) in place
+    uint32_t initramfs_first = 0, initramfs_last = 0;
+    if (bootloader_info.initramfs_size) {
+        initramfs_first = (bootloader_info.initramfs_base - dram_start) / PAGE_SIZE;
+        initramfs_last = (bootloader_info.initramfs_base + bootloader_info.initramfs_size - 1 - dram_start) / PAGE_SIZE;
+        alloc->free_pages -= initramfs_last - initramfs_first + 1;
+    }
+
     // Start loop from the last and work to the front
     for (uint32_t i = alloc->total_pages-1; i >= alloc->reserved_pages; i--) {
+        if (bootloader_info.initramfs_size && i >= initramfs_first && i <= initramfs_last) continue;
+
         // Physical address = DRAM start + page index * PAGE_SIZE
         uint32_t paddr = dram_start + (i * PAGE_SIZE);
         alloc->pages[i].paddr = (void*)paddr;
@@ -39,6 +49,9 @@ void init_page_allocator(struct page_allocator *alloc) {
     LOG(INFO, "Total pages: %d (%dKB)\n", alloc->total_pages, alloc->total_pages * PAGE_SIZE / 1024);
     LOG(INFO, "Reserved pages: %d (%dKB)\n", alloc->reserved_pages, alloc->reserved_pages * PAGE_SIZE / 1024);
     LOG(INFO, "Free pages: %d (%dKB)\n", alloc->free_pages, alloc->free_pages * PAGE_SIZE / 1024);
+    if (bootloader_info.initramfs_size) {
+        LOG(INFO, "Initramfs pages: %d (%dKB)\n", initramfs_last - initramfs_first + 1, (initramfs_last - initramfs_first + 1) * PAGE_SIZE / 1024);
+    }
     enable_interrupts();
 }
 
@@ -52,6 +65,8 @@ void* alloc_page(struct page_allocator *alloc) {
     struct page *desc = alloc->free_list;
     alloc->free_list = desc->next;
     alloc->free_pages--;
+    desc->refcount = 1;
+    desc->flags = 0;
 
     return desc->paddr;
 }
@@ -125,6 +140,33 @@ void free_page(struct page_allocator *alloc, void *ptr) {
     alloc->free_pages++;
 }
 
+// the allocator's own descriptor for an allocated page, NULL for anything it doesn't hand out
+struct page* page_desc(struct page_allocator *alloc, void *ptr) {
+    uint32_t page_index = (((uint32_t)ptr) - DRAM_BASE) / PAGE_SIZE;
+    if (page_index < alloc->reserved_pages || page_index >= alloc->total_pages) return NULL;
+
+    struct page *page = &alloc->pages[page_index];
+    return page->paddr == ptr ? page : NULL;
+}
+
+void page_get(struct page_allocator *alloc, void *ptr) {
+    struct page *page = page_desc(alloc, ptr);
+    if (!page) {
+        printk("Invalid page get: %p\n", ptr);
+        return;
+    }
+    page->refcount++;
+}
+
+void page_put(struct page_allocator *alloc, void *ptr) {
+    struct page *page = page_desc(alloc, ptr);
+    if (!page || page->refcount == 0) {
+        printk("Invalid page put: %p\n", ptr);
+        return;
+    }
+    if (--page->refcount == 0) free_page(alloc, ptr);
+}
+
 void free_aligned_pages(struct page_allocator *alloc, void *ptr, size_t count) {
     if (!ptr) return;
 
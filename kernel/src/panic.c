@@ -1,11 +1,14 @@
 #include <stdarg.h>
 #include <kernel/printk.h>
+#include <kernel/uart.h>
 
 void _panic(const char* file, const char* line, const char *fmt, ...){
      va_list args;
 
      // Disable interrupts (inline assembly)
      __asm__("cpsid i");
+     // flush what's already queued and switch the console to polled output
+     if (uart_driver.flush_sync) uart_driver.flush_sync();
      va_start(args, fmt);
 
      // TODO dump registers and stack, current process, other debug info
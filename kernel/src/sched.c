@@ -17,63 +17,135 @@
 #include <kernel/sleep.h>
 #include <kernel/log.h>
 #include <kernel/int.h>
+#include <kernel/slab.h>
 
 
 /* Globals */
-process_t process_table[MAX_PROCESSES]; // TODO dynamic processes
-
 process_t* current_process;
-process_t* next_process;
 
 /* Statics */
-static uint32_t total_processes;
-static uint32_t curr_pid;      // both of these could be kept in the scheduler struct
+static uint32_t curr_pid;      // could be kept in the scheduler struct
 static uint8_t asid_bitmap[MAX_ASID + 1] = {0};
+static struct list_head pid_hash[PID_HASH_SIZE];
+
+// processes come out of a slab, so the only limit on how many there are is memory
+static struct kmem_cache process_cache = KMEM_CACHE_INIT(process_cache, "process", process_t);
+static LIST_HEAD(all_processes);  // process_t.all_link
+static LIST_HEAD(run_queue);      // READY processes in the order they get the cpu, process_t.list
+static LIST_HEAD(dead_processes); // exited while still on their own kernel stack
+static process_t* idle_process;   // the null process, never queued, runs when nothing else can
+
+// freed kernel stacks kept around for the next fork, finding 2 aligned free pages gets
+// harder the longer the system runs
+#define KSTACK_CACHE_MAX 4
+static void* kstack_cache[KSTACK_CACHE_MAX];
+static uint32_t kstack_cached;
+
+// booted without an initramfs, /elf and /bin are only on the card mounted at /mnt
+#define CARD_MOUNT "/mnt"
+#define BINARY_PATH_MAX 128
+
+static vfs_dentry_t* lookup_binary(const char* path) {
+    vfs_dentry_t* dentry = vfs_root_node->inode->ops->lookup(vfs_root_node, path);
+    if (dentry && dentry->inode) return dentry;
+
+    char card_path[BINARY_PATH_MAX];
+    if (path[0] != '/' || strlen(path) + sizeof(CARD_MOUNT) > sizeof(card_path)) return NULL;
+    strcpy(card_path, CARD_MOUNT);
+    strcat(card_path, path);
+
+    dentry = vfs_root_node->inode->ops->lookup(vfs_root_node, card_path);
+    return dentry && dentry->inode ? dentry : NULL;
+}
 
-process_t* spawn_elf_init_process(const char* file_path) {
-    fat32_fs_t sd_card;
-    fat32_file_t userspace_application;
-    if (fat32_mount(&sd_card, &mmc_fat32_diskio) != 0) {
-        printk("Failed to mount SD card\n");
-        return NULL;
+// load an executable from the vfs. files that already sit in kernel memory (initramfs) are
+// used in place, anything else is read into a kernel buffer first
+binary_t* load_binary(const char* path) {
+    vfs_dentry_t* dentry = lookup_binary(path);
+    if (!dentry) return ERR_PTR(-ENOENT);
+
+    vfs_inode_t* inode = dentry->inode;
+    if (inode->flags & VFS_INODE_RAM) {
+        binary_t* bin = load_elf32(inode->private_data, inode->size);
+        if (!bin) return ERR_PTR(-EINVAL);
+
+        bin->data.elf.flags |= ELF_BINARY_PINNED;
+        return bin;
     }
-    if (fat32_open(&sd_card, file_path, &userspace_application)) {
-        printk("Failed to open file\n");
-        return NULL;
+
+    if (!inode->ops || !inode->ops->open || !inode->ops->read) return ERR_PTR(-ENOTSUP);
+
+    uint8_t* buffer = kmalloc(inode->size);
+    if (!buffer) return ERR_PTR(-ENOMEM);
+
+    vfs_file_t* file = inode->ops->open(dentry, OPEN_MODE_READ);
+    if (IS_ERR(file)) {
+        kfree(buffer);
+        return (binary_t*)file;
     }
 
-    uint8_t* buffer = kmalloc(userspace_application.file_size);
-    if (!buffer) {
-        printk("Failed to allocate buffer for ELF\n");
-        return NULL;
+    ssize_t read = inode->ops->read(file, buffer, inode->size);
+    kfree(file);
+    if (read != (ssize_t)inode->size) {
+        kfree(buffer);
+        return ERR_PTR(-EIO);
+    }
+
+    binary_t* bin = load_elf32(buffer, inode->size);
+    if (!bin) {
+        kfree(buffer);
+        return ERR_PTR(-EINVAL);
     }
+    return bin;
+}
+
+void free_binary(binary_t* bin) {
+    if (!(bin->data.elf.flags & ELF_BINARY_PINNED)) kfree(bin->data.elf.raw);
+    kfree(bin);
+}
 
-    if ((uint32_t)fat32_read(&userspace_application, buffer, userspace_application.file_size, 0) != userspace_application.file_size) {
-        printk("Init process not read fully off disk\n");
+process_t* spawn_elf_init_process(const char* file_path) {
+    binary_t* bin = load_binary(file_path);
+    if (IS_ERR(bin)) {
+        printk("Failed to load %s (%d)\n", file_path, PTR_ERR(bin));
         return NULL;
-    };
+    }
 
-    binary_t* init_bin = load_elf32(buffer, userspace_application.file_size);
-    return create_process(init_bin, NULL);
+    process_t* p = create_process(bin, NULL);
+    free_binary(bin);
+    return p;
 }
 
 static int32_t get_next_pid(void) {
     return curr_pid++;
 }
 
+static inline struct list_head* pid_bucket(int32_t pid) {
+    return &pid_hash[pid & (PID_HASH_SIZE - 1)];
+}
+
+// give p a fresh pid and make it findable by get_process_by_pid
+static void attach_pid(process_t* p) {
+    p->pid = get_next_pid();
+    list_add(&p->pid_link, pid_bucket(p->pid));
+}
+
 int scheduler_init(void) {
     scheduler_driver.current_tick = 0;
     current_process = NULL;
-    total_processes = 0;
     curr_pid = 0;
-    memset(process_table, 0, sizeof(process_table));
+    for (int i = 0; i < PID_HASH_SIZE; i++) INIT_LIST_HEAD(&pid_hash[i]);
 
 
     process_t* nullp = spawn_elf_init_process(NULL_PROCESS_FILE);
     if (!nullp) panic("Failed to start " NULL_PROCESS_FILE);
+    set_process_name(nullp, NULL_PROCESS_FILE);
+    list_del(&nullp->list); // schedule() falls back to it, it doesn't wait its turn
+    idle_process = nullp;
 
     process_t* initp = spawn_elf_init_process(INIT_PROCESS_FILE);
     if (!initp) panic("Failed to start " INIT_PROCESS_FILE);
+    set_process_name(initp, INIT_PROCESS_FILE);
     LOG(INFO, "Created init process\n");
 
     return 0;
@@ -93,88 +165,162 @@ uint8_t allocate_asid(void) {
     return 1;
 }
 
-// round robin scheduler
-process_t* get_next_process(void) {
-    uint32_t start;
-    if (current_process == NULL) {
-        start = 0;
+// switch_mm flushes the ASID every time it's switched in, so it can be handed out again right away
+static void free_asid(uint32_t asid) {
+    asid_bitmap[asid] = 0;
+}
+
+void sched_make_ready(process_t* p) {
+    uint32_t flags = local_irq_save();
+    p->state = PROCESS_READY;
+    if (p != idle_process) list_add_tail(&p->list, &run_queue);
+    local_irq_restore(flags);
+}
+
+// round robin, whoever has been waiting longest. Only the idle process is left when the queue is empty
+static process_t* get_next_process(void) {
+    if (list_empty(&run_queue)) return idle_process;
+
+    process_t* next = list_entry(run_queue.next, process_t, list);
+    list_del(&next->list);
+    return next;
+}
+
+// where the boot stack's registers go on the first switch, never resumed
+static struct cpu_context dead_context;
+
+static uint8_t* alloc_kernel_stack(void) {
+    uint32_t flags = local_irq_save();
+    uint8_t* kstack = NULL;
+
+    if (kstack_cached) {
+        kstack = kstack_cache[--kstack_cached];
     } else {
-        start = (current_process->pid + 1) % MAX_PROCESSES;
+        void* paddr = alloc_aligned_pages(&kpage_allocator, KSTACK_PAGES);
+        if (paddr) kstack = (uint8_t*)PHYS_TO_KERNEL_VIRT(paddr);
     }
-    uint32_t current = start;
-    do {
-        if (process_table[current].state == PROCESS_READY) {
-            return &process_table[current];
-        }
-        current = (current + 1) % MAX_PROCESSES;
-    } while (current != start);
 
-    return current_process; // If no other process found, return current one
+    local_irq_restore(flags);
+    return kstack;
 }
-void __attribute__((noreturn, naked)) user_context_return(uint32_t stack_ptr);
 
-void __attribute__ ((noreturn)) scheduler(void) {
-    // wake up sleeping processes if necessary
-    check_sleep_expiry();
-    // how do we decied on an order for waking sleep or blocked?
-    // wake up a blocked process if necessary
+static void free_kernel_stack(uint8_t* kstack) {
+    uint32_t flags = local_irq_save();
+    if (kstack_cached < KSTACK_CACHE_MAX) kstack_cache[kstack_cached++] = kstack;
+    else free_aligned_pages(&kpage_allocator, (void*)KERNEL_VIRT_TO_PHYS((uint32_t)kstack), KSTACK_PAGES);
+    local_irq_restore(flags);
+}
 
-    next_process = get_next_process();
-    if (next_process == NULL || next_process->state == PROCESS_NONE) {
-        panic("No more processes to run, halting!\n"); // this should never happen, so we panic
+// a zeroed process_t with its kernel stack, on none of the scheduler's lists yet
+static process_t* alloc_process(void) {
+    process_t* p = kmem_cache_alloc(&process_cache);
+    if (!p) return NULL;
+
+    memset(p, 0, sizeof(*p));
+    p->kstack = alloc_kernel_stack();
+    if (!p->kstack) {
+        kmem_cache_free(&process_cache, p);
+        return NULL;
     }
 
-    // printk("Starting process pid %u\n", next_process->pid);
-    // printk("Jumping to code at %p\n", *(uint32_t*)(next_process->stack_page_paddr + PAGE_SIZE - (3 * sizeof(uint32_t))));
-    // printk("Stack top: %p\n", next_process->stack_top);
+    INIT_LIST_HEAD(&p->list);
+    INIT_LIST_HEAD(&p->pid_link);
+    INIT_LIST_HEAD(&p->all_link);
+    mm_init(&p->mm);
+    wait_queue_init(&p->child_wait);
+    return p;
+}
 
-    // debug_l1_l2_entries((void*)0x00010000, next_process->ttbr0);
-    // printk("Phys=0x446A9000: %p", *(uint32_t*)0x446A9000);
-    mmu_driver.set_l1_with_asid(next_process->ttbr0, next_process->asid);
-    // Add TLB invalidation for the new ASID
+static void free_process_struct(process_t* p) {
+    if (p->kstack) free_kernel_stack(p->kstack); // a zombie's is already gone
+    kmem_cache_free(&process_cache, p);
+}
+
+// processes that went through process_exit, safe to touch once we're on another stack.
+// Released ones are freed whole, zombies only lose their kernel stack and wait for waitpid
+static void reap_dead_processes(void) {
+    process_t* p, *n;
+    list_for_each_entry_safe(p, process_t, n, &dead_processes, list) {
+        if (p == current_process) continue;
+        list_del(&p->list);
+        if (p->state == PROCESS_KILLED) {
+            free_kernel_stack(p->kstack);
+            p->kstack = NULL;
+            p->trapframe = NULL;
+        } else {
+            free_process_struct(p);
+        }
+    }
+}
+
+void flush_asid(uint32_t asid) {
     __asm__ volatile (
         "dsb ish\n"
         "mcr p15, 0, %0, c8, c7, 2\n"  // Invalidate TLB by ASID
         "dsb ish\n"
         "isb\n"
-        : : "r" (next_process->asid)
+        : : "r" (asid)
     );
+}
+
+// install p's page table and drop stale TLB entries for its ASID. kthreads only use the
+// kernel half, they keep whatever TTBR0 is loaded and save us the TLB flush
+static void switch_mm(process_t* p) {
+    if (p->flags & PROCESS_FLAG_KTHREAD) return;
 
-    current_process = next_process;
-    current_process->state = PROCESS_RUNNING;
+    mmu_driver.set_l1_with_asid(p->ttbr0, p->asid);
+    flush_asid(p->asid);
+}
+
+void schedule(void) {
+    uint32_t flags = local_irq_save();
+    process_t* prev = current_process;
+
+    // still runnable, just giving up the cpu. blocked/sleeping/killed are on their own lists
+    if (prev && prev->state == PROCESS_RUNNING) sched_make_ready(prev);
+
+    // wake up sleeping processes if necessary
+    check_sleep_expiry();
+
+    process_t* next = get_next_process();
     scheduler_driver.schedule_next = 0;
 
-    // TODO: This is a hack to fix the r0 register being written over at some point. this shouldn't be needed.
-    if (current_process->forked) {
-        if (current_process->stack_top[0] != 0) LOG(WARN, "Forked process wasn't set to return 0! (was %d)\n", current_process->stack_top[0]);
-        current_process->stack_top[0] = 0;
-        current_process->forked = 0;
+    if (next == prev && prev) {
+        prev->state = PROCESS_RUNNING; // nothing else to run
+        local_irq_restore(flags);
+        return;
     }
 
-    // TODO this is a hack, fix it. this WILL break.
-    // fix the stack from the compiler function prologue
-    __asm__ ("add sp, sp, #16\n");
-    // TO fix, we should have the scheduler setup in another function and return then pass to asm
-    // this way we won't have to deal with the compiler's prologue
-
-    // Direct tail call with forced assembly branch
-    register uint32_t stack_ptr __asm__("r0") = (uint32_t)next_process->stack_top;
-    __asm__ volatile(
-        "bx %0"
-        :
-        : "r" (user_context_return), "r" (stack_ptr)
-        : "memory"
-    );
+    if (next == NULL || next->state != PROCESS_READY) {
+        panic("No more processes to run, halting!\n"); // the null process is always runnable, this should never happen
+    }
+
+    switch_mm(next);
+    current_process = next;
+    next->state = PROCESS_RUNNING;
+
+    // comes back here once prev gets picked again
+    switch_to(prev ? &prev->context : &dead_context, &next->context);
+
+    reap_dead_processes();
+    local_irq_restore(flags);
+}
+
+void __attribute__ ((noreturn)) scheduler(void) {
+    schedule();
+    panic("A dead context was scheduled again!\n");
     __builtin_unreachable();
 }
 
-process_t* get_available_process(void) {
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (process_table[i].state == PROCESS_NONE) {
-            return &process_table[i];
-        }
-    }
-    return NULL;
+void cond_resched(void) {
+    uint32_t flags = local_irq_save();
+
+    // syscalls run with IRQs masked, open a window so a pending tick can land
+    enable_interrupts();
+    disable_interrupts();
+    if (scheduler_driver.schedule_next) schedule();
+
+    local_irq_restore(flags);
 }
 
 void get_kernel_regs(struct cpu_regs* regs) {
@@ -200,22 +346,14 @@ void get_kernel_regs(struct cpu_regs* regs) {
 void tick(void) {
     scheduler_driver.current_tick++; // increment the tick count
     if (scheduler_driver.current_tick % SCHEDULER_PREEMPT_TICKS == 0) {
-        scheduler_driver.schedule_next = 1;
-        if (current_process) current_process->state = PROCESS_READY;
-    }
-
-    if (scheduler_driver.current_tick % LOG_CONSUME_TICKS) {
-        log_consume();
+        scheduler_driver.schedule_next = 1; // schedule() requeues current if it's still running
     }
 }
 
-process_page_ref_t* create_page_ref(process_page_t* page) {
-    process_page_ref_t* ref = kmalloc(sizeof(process_page_ref_t));
-    if (!ref) return NULL;
-
-    INIT_LIST_HEAD(&ref->list);
-    ref->page = page;
-    return ref;
+// runs on the way back to userspace. Anything slow belongs in a kthread (the log is
+// drained by klogd), this only picks up a reschedule asked for by an IRQ or a wakeup
+void kernel_exit_work(void) {
+    if (scheduler_driver.schedule_next) schedule();
 }
 
 void mmu_set_l1_with_asid(uint32_t ttbr0, uint32_t asid) {
@@ -224,492 +362,462 @@ void mmu_set_l1_with_asid(uint32_t ttbr0, uint32_t asid) {
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
-process_page_t* alloc_process_page(void) {
-    process_page_t* page = kmalloc(sizeof(process_page_t));
-    if (!page) return NULL;
-
-    // printk("OK\n");
-    page->paddr = alloc_page(&kpage_allocator);
-    if (!page->paddr) {
-        kfree(page);
-        return NULL;
-    }
+// initialize the process memory table and other memory related fields
+// the entry code in vectors.S pushes exactly this much
+__extension__ _Static_assert(sizeof(struct trapframe) == 17 * sizeof(uint32_t), "struct trapframe doesn't match vectors.S");
+
+// the kernel stack comes with the process_t, see alloc_process
+static void initialize_kernel_stack(process_t* p) {
+    // same -4 as setup_stacks, keeps sp 8 byte aligned below the 68 byte trapframe
+    p->trapframe = (struct trapframe*)(p->kstack + KSTACK_SIZE - 4 - sizeof(struct trapframe));
+    memset(p->trapframe, 0, sizeof(struct trapframe));
+
+    // first switch_to lands in ret_to_user with sp at the trapframe
+    memset(&p->context, 0, sizeof(p->context));
+    p->context.sp = (uint32_t)p->trapframe;
+    p->context.lr = (uint32_t)ret_to_user;
+}
 
-    return page;
+// user registers for a fresh image: entry point, empty stack, user mode
+static void initialize_user_registers(process_t* p, binary_t* bin) {
+    memset(p->trapframe, 0, sizeof(struct trapframe));
+    p->trapframe->sp = MEMORY_USER_STACK_BASE + PAGE_SIZE;
+    p->trapframe->lr = 0xCAFEBABE; // TODO: set to exit handler backup when we have dynamic linking
+    p->trapframe->pc = bin->entry;
+    p->trapframe->cpsr = 0x10;     // user mode, IRQs on
 }
 
-// initialize the process memory table and other memory related fields
 static int initialize_process_memory(process_t* p) {
     p->ttbr0 = (uint32_t*) alloc_l1_table(&kpage_allocator);
     if (!p->ttbr0) return -ENOMEM;
 
-    INIT_LIST_HEAD(&p->pages_head);
+    mm_init(&p->mm);
     p->asid = allocate_asid();
     // other generic memory initialization
 
     return 0;
 }
 
-// load an elf binary into memory, allocating all required pages
-// static int load_elf_binary(process_t* p, binary_t* bin) {
-//     for (uint32_t i = 0; i < bin->data.elf.program_header_count; i++) {
-//         elf_program_header_t* phdr = &bin->data.elf.program_headers[i];
-//         if (phdr->p_type == ELF_PROGRAM_HEADER_TYPE_LOAD) {
-//             uint32_t page_count = (phdr->p_memsz + PAGE_SIZE - 1) / PAGE_SIZE;
-//             uint32_t vaddr_aligned = phdr->p_vaddr & ~(PAGE_SIZE - 1);
-
-//             bool is_code = phdr->p_flags & ELF_PROGRAM_HEADER_FLAG_EXECUTABLE;
-//             bool is_writable = phdr->p_flags & ELF_PROGRAM_HEADER_FLAG_WRITABLE;
-
-//             for (uint32_t j = 0; j < page_count; j++) {
-//                 process_page_t *page = alloc_process_page();
-//                 if (!page) return -ENOMEM;
-
-//                 page->vaddr = (void*) (vaddr_aligned + (j * PAGE_SIZE));
-//                 page->ref_count = 1;
+// pages, the mappings to them and the L2 tables, everything but the L1
+static void clear_user_memory(process_t* p) {
+    free_process_memory(p);
+    mmu_driver.free_user_tables(p->ttbr0);
+}
 
-//                 // Copy segment data into page
-//                 size_t copy_size = MIN(PAGE_SIZE, phdr->p_filesz - (j * PAGE_SIZE));
-//                 if (copy_size > 0) {
-//                     memcpy(PHYS_TO_KERNEL_VIRT(page->paddr), bin->data.elf.raw + phdr->p_offset + (j * PAGE_SIZE), copy_size);
-//                 }
+// all of p's user memory including its L1 and ASID
+static void free_address_space(process_t* p) {
+    clear_user_memory(p);
+    free_aligned_pages(&kpage_allocator, p->ttbr0, 4);
+    p->ttbr0 = NULL;
+    free_asid(p->asid);
+}
 
-//                 // Map page with appropriate permissions
-//                 uint32_t prot = MMU_NORMAL_MEMORY | MMU_SHAREABLE | MMU_EXECUTE_NEVER;
-//                 if (is_writable) prot |= PAGE_AP_FULL_ACCESS;
-//                 else prot |= PAGE_AP_USER_RO;
-//                 if (is_code) prot |= MMU_EXECUTE;
+// load an elf binary into memory, allocating and mapping all required pages
+static int load_elf_binary(process_t* p, binary_t* bin) {
+    for (uint32_t i = 0; i < bin->data.elf.program_header_count; i++) {
+        elf_program_header_t* phdr = &bin->data.elf.program_headers[i];
+        if (phdr->p_type != ELF_PROGRAM_HEADER_TYPE_LOAD) continue;
 
-//                 page->flags = prot;
+        // Calculate page-aligned address and offset within first page
+        uint32_t vaddr_aligned = phdr->p_vaddr & ~(PAGE_SIZE - 1);
+        uint32_t page_offset = phdr->p_vaddr - vaddr_aligned;
+        uint32_t page_count = (page_offset + phdr->p_memsz + PAGE_SIZE - 1) / PAGE_SIZE;
 
-//                 page->page_type = is_code ? PROCESS_PAGE_CODE : PROCESS_PAGE_DATA;
-//                 process_page_ref_t* ref = create_page_ref(page);
-//                 list_add_tail(&ref->list, &p->pages_head);
-//                 p->num_pages++;
-//             }
-//         }
-//     }
-//     return 0;
-// }
+        // Determine segment flags
+        bool is_code = phdr->p_flags & ELF_PROGRAM_HEADER_FLAG_EXECUTABLE;
+        bool is_writable = phdr->p_flags & ELF_PROGRAM_HEADER_FLAG_WRITABLE;
 
+        if (phdr->p_offset + phdr->p_filesz > bin->data.elf.size) {
+            printk("Error: ELF file offset out of bounds\n");
+            return -EINVAL;
+        }
 
-static int load_elf_binary(process_t* p, binary_t* bin) {
-    for (uint32_t i = 0; i < bin->data.elf.program_header_count; i++) {
-        elf_program_header_t* phdr = &bin->data.elf.program_headers[i];
-        if (phdr->p_type == ELF_PROGRAM_HEADER_TYPE_LOAD) {
-            // Calculate page-aligned address and offset within first page
-            uint32_t vaddr_aligned = phdr->p_vaddr & ~(PAGE_SIZE - 1);
-            uint32_t page_offset = phdr->p_vaddr - vaddr_aligned;
-
-            // Calculate total memory size needed (including alignment)
-            uint32_t total_mem_size = page_offset + phdr->p_memsz;
-            uint32_t page_count = (total_mem_size + PAGE_SIZE - 1) / PAGE_SIZE;
-
-            // Determine segment flags
-            bool is_code = phdr->p_flags & ELF_PROGRAM_HEADER_FLAG_EXECUTABLE;
-            bool is_writable = phdr->p_flags & ELF_PROGRAM_HEADER_FLAG_WRITABLE;
-
-            // Debug output
-            // printk("Loading segment: vaddr=0x%x, size=0x%x, offset=0x%x, flags=%c%c%c\n",
-            //        phdr->p_vaddr, phdr->p_memsz, phdr->p_offset,
-            //        is_code ? 'X' : '-',
-            //        is_writable ? 'W' : '-',
-            //        'R'); // Always readable
-
-            for (uint32_t j = 0; j < page_count; j++) {
-                // Calculate addresses for this page
-                uint32_t page_vaddr = vaddr_aligned + (j * PAGE_SIZE);
-
-                // Allocate a physical page
-                process_page_t *page = alloc_process_page();
-                if (!page) {
-                    printk("Failed to allocate page for process\n");
-                    return -ENOMEM;
-                }
-
-                // Clear the page first
-                memset(PHYS_TO_KERNEL_VIRT(page->paddr), 0, PAGE_SIZE);
-
-                // Calculate how much to copy from file for this page
-                uint32_t copy_offset = 0;
-                uint32_t copy_size = 0;
-
-                if (j == 0) {
-                    // First page - account for unaligned start
-                    copy_offset = page_offset;
-                    copy_size = MIN(PAGE_SIZE - page_offset, phdr->p_filesz);
-                } else {
-                    // Subsequent pages
-                    uint32_t segment_offset = (j * PAGE_SIZE) - page_offset;
-                    if (segment_offset < phdr->p_filesz) {
-                        copy_size = MIN(PAGE_SIZE, phdr->p_filesz - segment_offset);
-                        copy_offset = 0;
-                    }
-                }
-
-                // Copy data from file if needed
-                if (copy_size > 0) {
-                    uint32_t file_offset = phdr->p_offset;
-                    if (j == 0) {
-                        // First page
-                        file_offset += 0; // No additional offset needed
-                    } else {
-                        // Calculate offset into the file for this page
-                        file_offset += (j * PAGE_SIZE) - page_offset;
-                    }
-
-                    // printk("  Page %d: vaddr=0x%x, copy_size=0x%x, file_offset=0x%x\n",
-                    //        j, page_vaddr, copy_size, file_offset);
-
-                    // Copy data from file to page
-                    if (file_offset + copy_size <= bin->data.elf.size) {
-                        memcpy(PHYS_TO_KERNEL_VIRT(page->paddr) + copy_offset,
-                              bin->data.elf.raw + file_offset,
-                              copy_size);
-                    } else {
-                        printk("Error: ELF file offset out of bounds\n");
-                        return -EINVAL;
-                    }
-                }
-
-                // Set up page metadata
-                page->vaddr = (void*)page_vaddr;
-                page->ref_count = 1;
-
-                // Set up permissions - CRITICAL: Make sure these are consistent
-                uint32_t prot = MMU_NORMAL_MEMORY | MMU_SHAREABLE;
-
-                if (is_code) {
-                    // Code segment - executable, possibly read-only
-                    prot |= MMU_EXECUTE; // Enable execution
-                    prot &= ~MMU_EXECUTE_NEVER; // Ensure execute never is not set
-                    page->page_type = PROCESS_PAGE_CODE;
-                } else {
-                    // Data segment - not executable
-                    prot |= MMU_EXECUTE_NEVER; // Disable execution
-                    prot &= ~MMU_EXECUTE; // Ensure execute is not set
-                    page->page_type = PROCESS_PAGE_DATA;
-                }
-
-                // Set access permissions
-                if (is_writable) {
-                    prot |= PAGE_AP_FULL_ACCESS; // RW
-                } else {
-                    prot |= PAGE_AP_USER_RO; // RO
-                }
-
-                page->flags = prot;
-
-                // Add page to process
-                process_page_ref_t* ref = create_page_ref(page);
-                if (!ref) {
-                    printk("Failed to create page reference\n");
-                    return -ENOMEM;
-                }
-
-                list_add_tail(&ref->list, &p->pages_head);
-                p->num_pages++;
-            }
+        // read-only segments of a pinned image (initramfs) are mapped in place when the
+        // file layout lines up with pages, no copy and nothing to free later
+        uint32_t segment_src = (uint32_t)bin->data.elf.raw + phdr->p_offset - page_offset;
+        bool map_in_place = !is_writable
+            && (bin->data.elf.flags & ELF_BINARY_PINNED)
+            && phdr->p_filesz == phdr->p_memsz
+            && (segment_src & (PAGE_SIZE - 1)) == 0;
+
+        uint32_t prot = MMU_NORMAL_MEMORY | MMU_SHAREABLE;
+        prot |= is_code ? MMU_EXECUTE : MMU_EXECUTE_NEVER;
+        prot |= is_writable ? PAGE_AP_FULL_ACCESS : PAGE_AP_USER_RO;
+
+        uint32_t flags = (is_writable ? VMA_WRITE : 0) | (map_in_place ? VMA_PINNED : 0);
+        struct vm_area* vma = vma_create(&p->mm, vaddr_aligned, vaddr_aligned + page_count * PAGE_SIZE,
+                                         prot, is_code ? VMA_CODE : VMA_DATA, flags);
+        if (IS_ERR(vma)) return PTR_ERR(vma);
+
+        if (map_in_place) {
+            vma->backing = KERNEL_VIRT_TO_PHYS(segment_src);
+            if (vma_populate(&p->mm, p->ttbr0, vma) != 0) return -ENOMEM;
+            continue;
         }
-    }
 
-    return 0;
-}
+        for (uint32_t j = 0; j < page_count; j++) {
+            // the part of the file that lands in this page, whatever's past p_filesz stays zero (bss).
+            // Pages that are all bss are left to the fault handler, they start out on the zero page
+            uint32_t copy_offset = (j == 0) ? page_offset : 0;
+            uint32_t segment_offset = j * PAGE_SIZE + copy_offset - page_offset;
+            if (segment_offset >= phdr->p_filesz) break;
+
+            // big images take a while, don't hold up everything else
+            if (current_process) cond_resched();
 
-static int clone_parent_pages(process_t* p, process_t* parent) {
-    process_page_ref_t* current_ref;
-    list_for_each_entry(current_ref, process_page_ref_t, &parent->pages_head, list) {
-        process_page_t* current_page = current_ref->page;
-        if (current_page->page_type == PROCESS_PAGE_CODE) {
-            process_page_ref_t *new_ref = create_page_ref(current_page);
-            list_add_tail(&new_ref->list, &p->pages_head);
-            current_page->ref_count++;
-        } else if (current_page->page_type == PROCESS_PAGE_DATA) {
-            process_page_t* data_page = alloc_process_page();
-            if (!data_page) {
-                printk("Failed to allocate page for cloned process\n");
+            uint8_t* page = vma_alloc_page(&p->mm, p->ttbr0, vma, vaddr_aligned + j * PAGE_SIZE);
+            if (!page) {
+                printk("Failed to allocate page for process\n");
                 return -ENOMEM;
             }
 
-            memcpy(PHYS_TO_KERNEL_VIRT(data_page), PHYS_TO_KERNEL_VIRT(current_page->paddr), PAGE_SIZE);
-            process_page_ref_t *ref = create_page_ref(data_page);
-            list_add_tail(&ref->list, &p->pages_head);
+            uint32_t copy_size = MIN(PAGE_SIZE - copy_offset, phdr->p_filesz - segment_offset);
+            memcpy(page + copy_offset, bin->data.elf.raw + phdr->p_offset + segment_offset, copy_size);
         }
-        p->num_pages++;
     }
-    return 0;
-}
 
-static void clone_parent_fds(process_t* p, process_t* parent) {
-    for (int i = 0; i < MAX_FDS; i++) {
-        if (parent->fd_table[i]) {
-            p->fd_table[i] = parent->fd_table[i];
-            p->fd_table[i]->refcount++;
-        }
-    }
-    p->num_fds = parent->num_fds;
+    return 0;
 }
 
-// Helper function to setup stack and heap for the new process.
+// the stack gets its top page up front and grows down on demand, the heap starts out
+// empty and grows with brk
 static int setup_stack_and_heap(process_t* p) {
-    process_page_t* heap_page = alloc_process_page();
-    process_page_t* stack_page = alloc_process_page();
-    if (!stack_page || !heap_page) {
-        return -ENOMEM;
-    }
+    struct vm_area* stack = vma_create(&p->mm, MEMORY_USER_STACK_BASE, MEMORY_USER_STACK_BASE + PAGE_SIZE,
+                                       L2_USER_DATA_PAGE, VMA_STACK, VMA_WRITE | VMA_GROWSDOWN);
+    if (IS_ERR(stack)) return PTR_ERR(stack);
 
-    heap_page->vaddr = (void*)MEMORY_USER_HEAP_BASE;
-    heap_page->ref_count = 1;
-    heap_page->page_type = PROCESS_PAGE_HEAP;
-    heap_page->flags = L2_USER_DATA_PAGE;
-    p->num_pages++;
-    process_page_ref_t* ref = create_page_ref(heap_page);
-    list_add_tail(&ref->list, &p->pages_head);
-
-    stack_page->vaddr = (void*)MEMORY_USER_STACK_BASE;
-    stack_page->ref_count = 1;
-    stack_page->page_type = PROCESS_PAGE_STACK;
-    stack_page->flags = L2_USER_DATA_PAGE;
-    p->num_pages++;
-    p->stack_base_paddr = stack_page->paddr;
-    ref = create_page_ref(stack_page);
-    list_add_tail(&ref->list, &p->pages_head);
-
-    return 0;
+    p->mm.start_brk = p->mm.brk = MEMORY_USER_HEAP_BASE;
+    return vma_populate(&p->mm, p->ttbr0, stack);
 }
 
-static void copy_parent_stack_and_heap(process_t* p, process_t* parent) {
-    process_page_t* parent_stack_page = NULL;
-    process_page_t* parent_heap_page = NULL;
 
-    int count = 0;
-    process_page_ref_t* current_ref;
-    list_for_each_entry(current_ref, process_page_ref_t, &parent->pages_head, list) {
-        if (current_ref->page->page_type == PROCESS_PAGE_HEAP) {
-            parent_heap_page = current_ref->page;
-            count++;
-        } else if (current_ref->page->page_type == PROCESS_PAGE_STACK) {
-            parent_stack_page = current_ref->page;
-            count++;
-        }
-    }
+// stdin, stdout and stderr on the tty, an empty table hands out 0, 1, 2 in order
+static int install_console_fds(process_t* p) {
+    static const int modes[] = { OPEN_MODE_READ, OPEN_MODE_WRITE, OPEN_MODE_WRITE };
 
-    if (!parent_stack_page) {
-        panic("Parent process is missing a stack page!");
-    }
+    for (int i = 0; i < 3; i++) {
+        vfs_file_t* file = vfs_open("/dev/tty", modes[i]);
+        if (IS_ERR(file)) return PTR_ERR(file);
 
-    if (!parent_heap_page) {
-        panic("Parent process is missing a heap page!");
-    }
-
-    if (count > 2) {
-        panic("Parent process does not handle more than 2 currently.\n");
-    }
-
-    list_for_each_entry(current_ref, process_page_ref_t, &p->pages_head, list) {
-        if (current_ref->page->page_type == PROCESS_PAGE_HEAP) {
-            memcpy(PHYS_TO_KERNEL_VIRT(current_ref->page->paddr), PHYS_TO_KERNEL_VIRT(parent_heap_page->paddr), PAGE_SIZE);
-        } else if (current_ref->page->page_type == PROCESS_PAGE_STACK) {
-            memcpy(PHYS_TO_KERNEL_VIRT(current_ref->page->paddr), PHYS_TO_KERNEL_VIRT(parent_stack_page->paddr), PAGE_SIZE);
+        int fd = fd_install(&p->files, file);
+        if (fd < 0) {
+            vfs_file_put(file);
+            return fd;
         }
     }
+    return 0;
 }
 
+// give p a pid and make it runnable, it's visible to everyone from here on
+static void publish_process(process_t* p, int32_t ppid) {
+    uint32_t flags = local_irq_save();
+    attach_pid(p);
+    list_add_tail(&p->all_link, &all_processes);
+    p->ppid = ppid;
+    sched_make_ready(p);
+    local_irq_restore(flags);
+}
 
-// Main function to create a process. this should be made safer later.
-process_t* create_process(binary_t* bin, process_t* parent) {
-    process_page_ref_t* current_ref;
+// With bin the process gets a fresh image and parent only says who it belongs to, without
+// one it's a copy of parent (fork). files, if given, becomes the fd table on success
+static process_t* build_process(binary_t* bin, process_t* parent, struct fd_table* files) {
     if (!bin && !parent) {
         panic("No binary or parent process provided to create_process\n");
     }
 
-    process_t* p = get_available_process(); // allocate a new process
-    if (initialize_process_memory(p) != 0) return NULL;
+    process_t* p = alloc_process();
+    if (!p) return NULL;
+    initialize_kernel_stack(p);
+    if (initialize_process_memory(p) != 0) goto fail;
 
     if (bin) {
         if (bin->type == BINARY_TYPE_ELF32) {
-            if (load_elf_binary(p, bin) != 0) return NULL;
+            if (load_elf_binary(p, bin) != 0) goto fail;
+            if (setup_stack_and_heap(p) != 0) goto fail;
         } else {
             panic("Unsupported binary type\n");
         }
-    } else if (parent) {
-        if (clone_parent_pages(p, parent) != 0) return NULL;
-        clone_parent_fds(p, parent);
-        p->stack_top = parent->stack_top;
+        initialize_user_registers(p, bin);
     } else {
-        panic("No binary or parent process provided\n");
+        // every area comes along, the stack and heap included
+        if (mm_clone(&p->mm, p->ttbr0, &parent->mm, parent->ttbr0) != 0) goto fail;
+        *p->trapframe = *parent->trapframe; // child resumes right after the parent's svc
+        memcpy(p->process_name, parent->process_name, PROCESS_NAME_MAX);
     }
 
-    if (setup_stack_and_heap(p) != 0) return NULL;
-
-    if (parent) {
-        copy_parent_stack_and_heap(p, parent);
+    // fds last, nothing after this can fail so a handed in table is only taken on success
+    if (files) {
+        p->files = *files;
+    } else if (parent) {
+        if (fd_table_clone(&p->files, &parent->files) != 0) goto fail;
+    } else {
+        // processes the kernel starts get the tty as stdin, stdout and stderr
+        if (fd_table_init(&p->files) != 0 || install_console_fds(p) != 0) goto fail;
     }
 
-    process_page_ref_t *stack_ref;
-    process_page_t* stack_page = NULL;
-    list_for_each_entry(stack_ref, process_page_ref_t, &p->pages_head, list) {
-        if (stack_ref->page->page_type == PROCESS_PAGE_STACK) {
-            stack_page = stack_ref->page;
-            break;
-        }
-    }
+    publish_process(p, parent ? parent->pid : 0);
+    return p;
 
-    if (stack_page == NULL) {
-        LOG(ERROR, "Process created with no stack page! aborted!");
-        free_process_memory(p);
-        // TODO other cleanup, make sure everything is sorted.
-        return NULL;
-    }
+fail:
+    if (p->ttbr0) free_address_space(p);
+    fd_table_release(&p->files);
+    free_process_struct(p);
+    return NULL;
+}
 
-    // Set up the process entry point for the stack if binary exists
-    if (bin) {
-        p->stack_top = (uint32_t*)(MEMORY_USER_STACK_BASE + PAGE_SIZE - (16 * sizeof(uint32_t)));
-        uint32_t* sp_phys = PHYS_TO_KERNEL_VIRT(stack_page->paddr + PAGE_SIZE - (16 * sizeof(uint32_t)));
+process_t* create_process(binary_t* bin, process_t* parent) {
+    return build_process(bin, parent, NULL);
+}
 
-        sp_phys[13] = 0xCAFEBABE; // lr -- TODO: set to exit handler backup when we have dynamic linking
-        sp_phys[14] = 0x10; // cpsr
-        sp_phys[15] = bin->entry; // pc
-    }
+process_t* spawn_process(binary_t* bin, process_t* parent, struct fd_table* files) {
+    return build_process(bin, parent, files);
+}
 
-    // map all the pages to the process page table
-    list_for_each_entry(current_ref, process_page_ref_t, &p->pages_head, list) {
-        mmu_driver.map_page(p->ttbr0, current_ref->page->vaddr, current_ref->page->paddr, current_ref->page->flags);
-    }
+process_t* vfork_process(process_t* parent) {
+    process_t* p = alloc_process();
+    if (!p) return NULL;
+    initialize_kernel_stack(p);
 
+    if (fd_table_clone(&p->files, &parent->files) != 0) {
+        free_process_struct(p);
+        return NULL;
+    }
 
-    // set up initial process fds
-    p->fd_table[0] = vfs_open("/dev/uart0", OPEN_MODE_READ | OPEN_MODE_NOBLOCK);
-    p->fd_table[1] = vfs_open("/dev/uart0", OPEN_MODE_WRITE);
-    p->fd_table[2] = vfs_open("/dev/uart0", OPEN_MODE_WRITE);
-    p->num_fds = 3;
+    // no pages of its own, it runs on the parent's page table until exec or exit
+    p->flags = PROCESS_FLAG_VFORK;
+    p->ttbr0 = parent->ttbr0;
+    p->asid = parent->asid;
+    *p->trapframe = *parent->trapframe;
+    memcpy(p->process_name, parent->process_name, PROCESS_NAME_MAX);
 
-    p->state = PROCESS_READY;
-    p->pid = get_next_pid();
-    p->ppid = parent ? parent->pid : 0;
+    publish_process(p, parent->pid);
     return p;
 }
 
+struct mm* process_mm(process_t* p) {
+    if (p->flags & PROCESS_FLAG_VFORK) {
+        process_t* parent = get_process_by_pid(p->ppid);
+        if (parent) return &parent->mm;
+    }
+    return &p->mm;
+}
+
+// p is done with the parent's address space, let the parent run again. p->ttbr0 is the
+// caller's to change, it may still be loaded
+static void vfork_done(process_t* p) {
+    p->flags &= ~PROCESS_FLAG_VFORK;
 
-void free_process_page(process_page_t* process_page) {
-    free_page(&kpage_allocator, process_page->paddr);
-    kfree(process_page);
+    process_t* parent = get_process_by_pid(p->ppid);
+    if (parent) wake_up_all(&parent->child_wait);
 }
 
+
 // free specifically only memory from the process
 void free_process_memory(process_t* p) {
-    process_page_ref_t* ref, *next;
-    list_for_each_entry_safe(ref, process_page_ref_t, next, &p->pages_head, list) {
-        if (ref->page->ref_count == 0) panic("ref_count is 0");
-        else if (ref->page->ref_count == 1) {
-            free_process_page(ref->page);
-        } else {
-            ref->page->ref_count--; // // TODO free pages in l1 table of process:
-            // remove l2 entry and free page
-        }
+    mm_release(&p->mm, p->ttbr0); // the mappings go with the L2 tables, see clear_user_memory
+}
 
-        list_del(&ref->list);
-        kfree(ref);
-        p->num_pages--;
-    }
 
+// a vfork child's new image is built next to the borrowed address space, which only goes back
+// to the parent once that worked. A failed exec still has somewhere to return the error to
+static int vfork_exec_image(process_t* p, binary_t* bin) {
+    uint32_t* borrowed = p->ttbr0;
+    uint32_t borrowed_asid = p->asid;
 
-}
+    int err = initialize_process_memory(p);
+    if (!err) err = load_elf_binary(p, bin);
+    if (!err) err = setup_stack_and_heap(p);
 
+    if (err) {
+        // a cond_resched in the load may have switched to the new table, get off it first
+        mmu_driver.set_l1_with_asid(borrowed, borrowed_asid);
+        flush_asid(borrowed_asid);
+        if (p->ttbr0) free_address_space(p);
+        p->ttbr0 = borrowed;
+        p->asid = borrowed_asid;
+        return err;
+    }
 
-// TODO clean this up
-__attribute__((naked, noreturn)) void userspace_return(void) {
-    __asm__ volatile(
-        "ldr r3, =scheduler_driver\n\t"
-        "ldr r3, [r3]\n\t"
-        "cmp r3, #0\n\t"
-        "beq 1f\n\t"
-        "b scheduler\n"
-        "1:\n\t"
-        "ldr r3, =current_process\n\t"
-        "ldr r3, [r3]\n\t"
-        "ldr r0, [r3, %[ttbr0_off]]\n\t"
-        "ldr r1, [r3, %[asid_off]]\n\t"
-        "bl mmu_set_l1_with_asid\n\t"
-        "ldr r3, =current_process\n\t"
-        "ldr r3, [r3]\n\t"
-        "ldr r0, [r3, %[stack_off]]\n\t"
-        "b user_context_return\n\t"
-        :
-        : [ttbr0_off] "i" (offsetof(process_t, ttbr0)),
-          [asid_off] "i" (offsetof(process_t, asid)),
-          [stack_off] "i" (offsetof(process_t, stack_top))
-    );
+    vfork_done(p);
+    return 0;
 }
 
 // for exec* syscalls
 int swap_process(binary_t* bin, process_t* p) {
-    process_page_ref_t* current_ref;
     if (!bin || !p) {
         return -1;
     }
-    p->state = PROCESS_UNINTERUPTABLE;
-
-    /* free the old process memory */
-    free_process_memory(p);
 
     if (bin->type != BINARY_TYPE_ELF32) {
         panic("Flat binaries aren't supported at this time!");
     }
 
-    if (initialize_process_memory(p) != 0) return -1;
+    if (p->flags & PROCESS_FLAG_VFORK) {
+        if (vfork_exec_image(p, bin) != 0) return -1;
+    } else {
+        // tear the old image down in place, the L1 and ASID stay. That saves hunting for
+        // another 16KB aligned run, and the ASID flush covers whatever the TLB still holds
+        clear_user_memory(p);
+        flush_asid(p->asid);
+
+        if (load_elf_binary(p, bin) != 0) return -1;
+        if (setup_stack_and_heap(p) != 0) return -1;
+    }
+
+    // the trapframe is what exec returns through, point it at the new image
+    initialize_user_registers(p, bin);
 
-    if (load_elf_binary(p, bin) != 0) return -1;
+    switch_mm(p);
+    return 0;
+}
 
-    if (setup_stack_and_heap(p) != 0) return -1;
+scheduler_t scheduler_driver = {
+    .schedule_next = 0,
+    .tick = tick,
+};
 
-    process_page_ref_t *stack_ref;
-    process_page_t* stack_page = NULL;
-    list_for_each_entry(stack_ref, process_page_ref_t, &p->pages_head, list) {
-        if (stack_ref->page->page_type == PROCESS_PAGE_STACK) {
-            stack_page = stack_ref->page;
-            break;
-        }
+process_t* get_process_by_pid(int32_t pid) {
+    process_t* p;
+    list_for_each_entry(p, process_t, pid_bucket(pid), pid_link) {
+        if (p->pid == pid) return p;
     }
+    return NULL;
+}
 
-    if (stack_page == NULL) {
-        LOG(ERROR, "Process created with no stack page! aborted!");
-        free_process_memory(p);
-        // TODO other cleanup, make sure everything is sorted.
-        return -1;
+void release_process(process_t* p) {
+    uint32_t flags = local_irq_save();
+    list_del(&p->pid_link);
+    list_del(&p->all_link);
+    p->state = PROCESS_NONE;
+
+    // a process releasing itself is still running on its kernel stack, schedule() frees it
+    // once it has switched away
+    if (p == current_process) {
+        list_add(&p->list, &dead_processes);
+    } else {
+        // a zombie nobody has switched away from yet still has its stack and sits on dead_processes
+        if (p->kstack) list_del(&p->list);
+        free_process_struct(p);
     }
+    local_irq_restore(flags);
+}
 
+// hand p's children to init. Zombies among them would never be waited for, reap them now
+static void reparent_children(process_t* p) {
+    process_t* child, *n;
+    list_for_each_entry_safe(child, process_t, n, &all_processes, all_link) {
+        if (child == p || child->ppid != p->pid) continue;
+        if (child->flags & PROCESS_FLAG_KTHREAD) continue;
+
+        child->ppid = INIT_PID;
+        child->flags |= PROCESS_FLAG_ORPHAN;
+        if (child->state == PROCESS_KILLED) release_process(child);
+    }
+}
 
-    p->stack_top = (uint32_t*)(MEMORY_USER_STACK_BASE + PAGE_SIZE - (16 * sizeof(uint32_t)));
-    uint32_t* sp_phys = PHYS_TO_KERNEL_VIRT(stack_page->paddr + PAGE_SIZE - (16 * sizeof(uint32_t)));
+void __attribute__ ((noreturn)) process_exit(int status) {
+    process_t* p = current_process;
+    disable_interrupts();
 
-    sp_phys[13] = 0xCAFEBABE; // lr -- TODO: set to exit handler backup when we have dynamic linking
-    sp_phys[14] = 0x10; // cpsr
-    sp_phys[15] = bin->entry; // pc
+    fd_table_release(&p->files);
 
-    // map all the pages to the process page table
-    list_for_each_entry(current_ref, process_page_ref_t, &p->pages_head, list) {
-        mmu_driver.map_page(p->ttbr0, current_ref->page->vaddr, current_ref->page->paddr, current_ref->page->flags);
+    if (p->flags & PROCESS_FLAG_VFORK) {
+        vfork_done(p); // nothing of its own to free
+        p->ttbr0 = NULL;
+        p->asid = 0;
+    } else if (!(p->flags & PROCESS_FLAG_KTHREAD)) {
+        // get off our L1 first. A kthread picked next keeps whatever TTBR0 holds, and the
+        // idle process's table is the one that's never freed
+        switch_mm(idle_process);
+        free_address_space(p);
     }
 
-    current_process->state = PROCESS_READY;
-    scheduler_driver.schedule_next = 1;
+    reparent_children(p);
 
-    return 0;
+    p->exit_status = status;
+    p->state = PROCESS_KILLED;
+
+    // processes the kernel started (ppid 0) and adopted ones have nobody to collect them,
+    // they're freed as soon as we've switched off this kernel stack. Unless init is already
+    // blocked in waitpid on the orphan, then it stays a zombie for init to reap like any child
+    process_t* parent = get_process_by_pid(p->ppid);
+    if (p->ppid == 0 || !parent || ((p->flags & PROCESS_FLAG_ORPHAN) && !(p->flags & PROCESS_FLAG_WAITED))) {
+        release_process(p);
+    } else {
+        // waitpid only needs the process_t, the kernel stack goes once we're off it
+        list_add(&p->list, &dead_processes);
+        wake_up_all(&parent->child_wait);
+    }
+
+    scheduler();
 }
 
-scheduler_t scheduler_driver = {
-    .schedule_next = 0,
-    .tick = tick,
-};
+process_t* kthread_create(kthread_fn_t fn, void* arg, const char* name) {
+    process_t* p = alloc_process();
+    if (!p) return ERR_PTR(-ENOMEM);
+    initialize_kernel_stack(p);
 
-process_t* get_process_by_pid(int32_t pid) {
+    // no user side at all, the trapframe space just sits unused above sp
+    p->context.lr = (uint32_t)kthread_start;
+    p->context.r4 = (uint32_t)fn;
+    p->context.r5 = (uint32_t)arg;
+
+    // alloc_process zeroed the rest: no page table, no pages, no fds
+    p->flags = PROCESS_FLAG_KTHREAD;
+    set_process_name(p, name);
+
+    publish_process(p, 0);
+
+    LOG(INFO, "Started kthread %s (pid %d)\n", name, p->pid);
+    return p;
+}
+
+void __attribute__ ((noreturn)) kthread_exit(int status) {
+    disable_interrupts();
+    if (!(current_process->flags & PROCESS_FLAG_KTHREAD)) panic("kthread_exit from a user process");
+
+    LOG(INFO, "kthread %s exited with %d\n", current_process->process_name, status);
+    process_exit(status);
+}
+
+void set_process_name(process_t* p, const char* path) {
+    const char* name = path;
+    for (const char* c = path; *c; c++) {
+        if (*c == '/' && c[1]) name = c + 1;
+    }
+
+    strncpy(p->process_name, name, PROCESS_NAME_MAX - 1);
+    p->process_name[PROCESS_NAME_MAX - 1] = '\0';
+}
+
+static const char* process_state_name(uint32_t state) {
+    switch (state) {
+        case PROCESS_RUNNING:        return "running";
+        case PROCESS_READY:          return "ready";
+        case PROCESS_BLOCKED:        return "blocked";
+        case PROCESS_SLEEPING:       return "sleeping";
+        case PROCESS_KILLED:         return "zombie";
+        case PROCESS_UNINTERUPTABLE: return "busy";
+        default:                     return "?";
+    }
+}
+
+int sched_format_processes(char* buf, size_t size) {
+    int len = snprintf(buf, size, "%5s %5s %-9s %s\n", "PID", "PPID", "STATE", "NAME");
+
+    uint32_t flags = local_irq_save();
     process_t* p;
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        p = &process_table[i];
-        if (p->pid == pid) {
-            return p;
+    list_for_each_entry(p, process_t, &all_processes, all_link) {
+        if (len >= (int)size - 1) break;
+
+        // kthreads get brackets, like ps does on linux
+        if (p->flags & PROCESS_FLAG_KTHREAD) {
+            len += snprintf(buf + len, size - len, "%5d %5d %-9s [%s]\n", p->pid, p->ppid, process_state_name(p->state), p->process_name);
+        } else {
+            len += snprintf(buf + len, size - len, "%5d %5d %-9s %s\n", p->pid, p->ppid, process_state_name(p->state), p->process_name);
         }
     }
-    return NULL;
+    local_irq_restore(flags);
+
+    return len;
 }
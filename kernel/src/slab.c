@@ -0,0 +1,105 @@
+#include <kernel/slab.h>
+#include <kernel/paging.h>
+#include <kernel/panic.h>
+#include <kernel/mm.h>
+#include <kernel/int.h>
+
+struct slab {
+    struct list_head list;     // on the cache's partial or full list
+    struct kmem_cache* cache;
+    void* free;                // first free object, each one points at the next
+    uint32_t in_use;
+    uint32_t capacity;
+};
+
+#define SLAB_HEADER_SIZE ((sizeof(struct slab) + 7) & ~7u)
+
+static inline struct slab* slab_of(void* obj) {
+    return (struct slab*)((uint32_t)obj & ~(PAGE_SIZE - 1));
+}
+
+static struct slab* slab_create(struct kmem_cache* cache) {
+    void* paddr = alloc_page(&kpage_allocator);
+    if (!paddr) return NULL;
+
+    struct slab* slab = (struct slab*)PHYS_TO_KERNEL_VIRT(paddr);
+    uint8_t* obj = (uint8_t*)slab + SLAB_HEADER_SIZE;
+
+    slab->cache = cache;
+    slab->in_use = 0;
+    slab->capacity = (PAGE_SIZE - SLAB_HEADER_SIZE) / cache->obj_size;
+    slab->free = NULL;
+
+    // thread the free list back to front so objects come out in address order
+    for (int i = slab->capacity - 1; i >= 0; i--) {
+        void** o = (void**)(obj + i * cache->obj_size);
+        *o = slab->free;
+        slab->free = o;
+    }
+
+    cache->slabs++;
+    return slab;
+}
+
+static void slab_destroy(struct kmem_cache* cache, struct slab* slab) {
+    cache->slabs--;
+    free_page(&kpage_allocator, (void*)KERNEL_VIRT_TO_PHYS((uint32_t)slab));
+}
+
+void* kmem_cache_alloc(struct kmem_cache* cache) {
+    struct slab* slab;
+    uint32_t flags = local_irq_save();
+
+    if (!list_empty(&cache->partial)) {
+        slab = list_entry(cache->partial.next, struct slab, list);
+    } else {
+        if (cache->empty) {
+            slab = cache->empty;
+            cache->empty = NULL;
+        } else if (!(slab = slab_create(cache))) {
+            local_irq_restore(flags);
+            return NULL;
+        }
+        list_add(&slab->list, &cache->partial);
+    }
+
+    void** obj = slab->free;
+    slab->free = *obj;
+    slab->in_use++;
+    cache->in_use++;
+
+    if (!slab->free) {
+        list_del(&slab->list);
+        list_add(&slab->list, &cache->full);
+    }
+
+    local_irq_restore(flags);
+    return obj;
+}
+
+void kmem_cache_free(struct kmem_cache* cache, void* obj) {
+    if (!obj) return;
+
+    struct slab* slab = slab_of(obj);
+    if (slab->cache != cache) panic("kmem_cache_free: %p doesn't belong to %s\n", obj, cache->name);
+
+    uint32_t flags = local_irq_save();
+    int was_full = !slab->free;
+
+    *(void**)obj = slab->free;
+    slab->free = obj;
+    slab->in_use--;
+    cache->in_use--;
+
+    if (!slab->in_use) {
+        list_del(&slab->list);
+        // keep one spare, anything more goes back to the page allocator
+        if (cache->empty) slab_destroy(cache, slab);
+        else cache->empty = slab;
+    } else if (was_full) {
+        list_del(&slab->list);
+        list_add(&slab->list, &cache->partial);
+    }
+
+    local_irq_restore(flags);
+}
@@ -1,23 +1,38 @@
 #include <kernel/sleep.h>
 #include <kernel/time.h>
 #include <kernel/timer.h>
+#include <kernel/int.h>
 
-sleep_queue_t sleep_queue;
+// sleeping processes sorted by wake time (process_t.list), so expiry only looks at the front
+static LIST_HEAD(sleep_list);
+
+void sleep_until(uint64_t wake_ticks) {
+    uint32_t flags = local_irq_save();
+    process_t* p = current_process;
+    struct list_head* pos;
+
+    p->wake_ticks = wake_ticks;
+    p->state = PROCESS_SLEEPING;
+
+    // after everyone waking at the same time, keeps it fifo
+    list_for_each(pos, &sleep_list) {
+        process_t* other = list_entry(pos, process_t, list);
+        if (other->wake_ticks > wake_ticks) break;
+    }
+    list_add_tail(&p->list, pos);
+
+    schedule(); // back once check_sleep_expiry has made us READY and we get picked
+    local_irq_restore(flags);
+}
 
-// only wake up the top process that is sleeping
 void check_sleep_expiry(void) {
     uint64_t current_ticks = clock_timer.get_ticks();
 
-    for (uint32_t i = 0; i < sleep_queue.count; ) {
-        process_t* proc = sleep_queue.procs[i];
-
-        if (current_ticks >= proc->wake_ticks) {
-            proc->state = PROCESS_READY;
+    while (!list_empty(&sleep_list)) {
+        process_t* proc = list_entry(sleep_list.next, process_t, list);
+        if (current_ticks < proc->wake_ticks) break;
 
-            // Remove from queue (swap with last)
-            sleep_queue.procs[i] = sleep_queue.procs[--sleep_queue.count];
-        } else {
-            i++;  // Proceed if not expired
-        }
+        list_del(&proc->list);
+        sched_make_ready(proc);
     }
 }
@@ -0,0 +1,87 @@
+#include <kernel/softirq.h>
+#include <kernel/int.h>
+#include <kernel/panic.h>
+
+static void tasklet_action(void);
+
+static softirq_fn_t softirq_vec[NR_SOFTIRQS] = {
+    [SOFTIRQ_TASKLET] = tasklet_action,
+};
+static volatile uint32_t softirq_pending;  // bit per softirq_nr
+static uint8_t softirq_active;             // set while do_softirq is running, it doesn't nest
+
+static LIST_HEAD(tasklet_queue);
+
+void open_softirq(enum softirq_nr nr, softirq_fn_t fn) {
+    if (nr >= NR_SOFTIRQS) panic("Invalid softirq %d", nr);
+    softirq_vec[nr] = fn;
+}
+
+void raise_softirq(enum softirq_nr nr) {
+    uint32_t flags = local_irq_save();
+    softirq_pending |= 1 << nr;
+    local_irq_restore(flags);
+}
+
+// IRQs masked on entry and on return, on while the handlers run
+static void do_softirq(void) {
+    uint32_t pending;
+    int restarts = SOFTIRQ_MAX_RESTART;
+
+    softirq_active = 1;
+    while ((pending = softirq_pending) && restarts--) {
+        softirq_pending = 0;
+        enable_interrupts();
+
+        while (pending) {
+            uint32_t nr = __builtin_ctz(pending);
+            if (softirq_vec[nr]) softirq_vec[nr]();
+            pending &= pending - 1;
+        }
+
+        disable_interrupts();
+    }
+    softirq_active = 0;
+}
+
+void irq_exit(void) {
+    // an irq that lands while softirqs run leaves its work for the outer loop
+    if (softirq_pending && !softirq_active) do_softirq();
+}
+
+void tasklet_schedule(struct tasklet* t) {
+    uint32_t flags = local_irq_save();
+    if (!t->scheduled) {
+        t->scheduled = 1;
+        list_add_tail(&t->list, &tasklet_queue);
+        softirq_pending |= 1 << SOFTIRQ_TASKLET;
+    }
+    local_irq_restore(flags);
+}
+
+static void tasklet_action(void) {
+    struct list_head list;
+
+    // take the whole queue, anything scheduled from here on goes round again
+    disable_interrupts();
+    if (list_empty(&tasklet_queue)) {
+        enable_interrupts();
+        return;
+    }
+    list.next = tasklet_queue.next;
+    list.prev = tasklet_queue.prev;
+    list.next->prev = &list;
+    list.prev->next = &list;
+    INIT_LIST_HEAD(&tasklet_queue);
+    enable_interrupts();
+
+    while (!list_empty(&list)) {
+        disable_interrupts();
+        struct tasklet* t = list_entry(list.next, struct tasklet, list);
+        list_del(&t->list);
+        t->scheduled = 0; // can be queued again while it runs
+        enable_interrupts();
+
+        t->fn(t->data);
+    }
+}
@@ -84,8 +84,29 @@ static int int64_to_str(char *buf, size_t len, int64_t num, int base) {
 //     return written + uint_to_str(buf + written, len - written, num, base);
 // }
 
+// where conversions pull their arguments from, either a va_list or an array of
+// 32-bit words (deferred log records). 64-bit values take two words, low first
+struct fmt_args {
+    va_list* args;
+    const uint32_t* words;
+    size_t nwords;
+};
+
+static uint32_t fmt_next_word(struct fmt_args* src) {
+    if (!src->words) return va_arg(*src->args, uint32_t);
+    if (!src->nwords) return 0;
+    src->nwords--;
+    return *src->words++;
+}
+
+static uint64_t fmt_next_dword(struct fmt_args* src) {
+    if (!src->words) return va_arg(*src->args, uint64_t);
+    uint32_t lo = fmt_next_word(src);
+    return ((uint64_t)fmt_next_word(src) << 32) | lo;
+}
+
 // TODO - improve feature set
-int vsnprintf(char *buf, size_t size, const char *fmt, va_list args) {
+static int format(char *buf, size_t size, const char *fmt, struct fmt_args* src) {
     int written = 0;
     const char *p = fmt;
     char num_buf[32];
@@ -115,7 +136,7 @@ int vsnprintf(char *buf, size_t size, const char *fmt, va_list args) {
 parse_width:
         // Parse width
         if (*p == '*') {
-            pad_width = va_arg(args, int);
+            pad_width = (int)fmt_next_word(src);
             p++;
         } else {
             while (*p >= '0' && *p <= '9') {
@@ -143,23 +164,22 @@ parse_width:
         char *str = NULL;
         int prefix_len = 0;
         char prefix[4] = {0};
+        char ch[2] = {0};
 
         // Handle specifier
         switch (spec) {
             case 'd':
             case 'i':
                 is_signed = 1;
-                if (length == 0) num_s = va_arg(args, int);
-                else if (length == 1) num_s = va_arg(args, long);
-                else num_s = va_arg(args, long long);
+                if (length < 2) num_s = (int32_t)fmt_next_word(src); // long is 32 bits here
+                else num_s = (int64_t)fmt_next_dword(src);
                 break;
 
             case 'u':
             case 'x':
             case 'X':
-                if (length == 0) num_u = va_arg(args, unsigned int);
-                else if (length == 1) num_u = va_arg(args, unsigned long);
-                else num_u = va_arg(args, unsigned long long);
+                if (length < 2) num_u = fmt_next_word(src);
+                else num_u = fmt_next_dword(src);
 
                 if (spec == 'x' || spec == 'X') {
                     base = 16;
@@ -168,7 +188,7 @@ parse_width:
                 break;
 
             case 'p':
-                num_u = (uintptr_t)va_arg(args, void*);
+                num_u = fmt_next_word(src);
                 base = 16;
                 prefix[0] = '0';
                 prefix[1] = 'x';
@@ -176,14 +196,14 @@ parse_width:
                 break;
 
             case 's':
-                str = va_arg(args, char*);
+                str = (char*)(uintptr_t)fmt_next_word(src);
+                if (!str) str = "(null)";
                 break;
 
-            case 'c': {
-                char c = (char)va_arg(args, int);
-                str = &c;
+            case 'c':
+                ch[0] = (char)fmt_next_word(src);
+                str = ch;
                 break;
-            }
 
             case '%':
                 str = "%";
@@ -250,6 +270,20 @@ parse_width:
     return written;
 }
 
+int vsnprintf(char *buf, size_t size, const char *fmt, va_list args) {
+    va_list args_copy;
+    va_copy(args_copy, args);
+    struct fmt_args src = { .args = &args_copy };
+    int len = format(buf, size, fmt, &src);
+    va_end(args_copy);
+    return len;
+}
+
+int snprintf_words(char *buf, size_t size, const char *fmt, const uint32_t* words, size_t nwords) {
+    struct fmt_args src = { .words = words, .nwords = nwords };
+    return format(buf, size, fmt, &src);
+}
+
 int snprintf(char *buf, size_t size, const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
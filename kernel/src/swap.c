@@ -0,0 +1,114 @@
+#include <kernel/swap.h>
+#include <kernel/paging.h>
+#include <kernel/heap.h>
+#include <kernel/errno.h>
+#include <kernel/log.h>
+#include <kernel/printk.h>
+
+#define SWAP_FILE  "/SWAPFILE"
+#define SWAP_SIZE  (8 * 1024 * 1024)
+#define SWAP_SLOTS (SWAP_SIZE / PAGE_SIZE)
+
+static fat32_fs_t* swap_fs;
+static uint32_t* cluster_sector;            // first sector of every cluster of the file, in file order
+static uint32_t slot_map[SWAP_SLOTS / 32];  // bit set = slot in use
+static uint32_t next_slot;                  // next fit, carry on from the last slot handed out
+static uint32_t slots_used;
+
+int swap_init(fat32_fs_t* fs) {
+    fat32_file_t file;
+    if (fat32_open(fs, SWAP_FILE, &file) != FAT32_SUCCESS
+        && (fat32_create(fs, SWAP_FILE) != FAT32_SUCCESS || fat32_open(fs, SWAP_FILE, &file) != FAT32_SUCCESS)) {
+        LOG(WARN, "swap: can't create %s\n", SWAP_FILE);
+        return -EIO;
+    }
+
+    // writing the last byte allocates every cluster before it, what's in them doesn't matter
+    if (file.file_size < SWAP_SIZE) {
+        uint8_t zero = 0;
+        if (fat32_write(&file, &zero, 1, SWAP_SIZE - 1) != 1) {
+            LOG(WARN, "swap: no room for %dKB of swap\n", SWAP_SIZE / 1024);
+            return -ENOSPC;
+        }
+    }
+
+    uint32_t clusters = (SWAP_SIZE + fs->cluster_size - 1) / fs->cluster_size;
+    cluster_sector = kmalloc(clusters * sizeof(uint32_t));
+    if (!cluster_sector) return -ENOMEM;
+
+    // errors come back as huge cluster numbers, so this catches them along with a short chain
+    uint32_t cluster = file.start_cluster;
+    for (uint32_t i = 0; i < clusters; i++) {
+        if (cluster < 2 || cluster >= FAT32_EOC_MARKER) {
+            LOG(WARN, "swap: %s is shorter than it says\n", SWAP_FILE);
+            kfree(cluster_sector);
+            cluster_sector = NULL;
+            return -EIO;
+        }
+        cluster_sector[i] = fat32_cluster_to_sector(fs, cluster);
+        cluster = fat32_get_next_cluster(fs, cluster);
+    }
+
+    swap_fs = fs;
+    LOG(INFO, "swap: %dKB in %s\n", SWAP_SIZE / 1024, SWAP_FILE);
+    return 0;
+}
+
+uint32_t swap_free_slots(void) {
+    return cluster_sector ? SWAP_SLOTS - slots_used : 0;
+}
+
+static int slot_alloc(void) {
+    if (slots_used == SWAP_SLOTS) return -ENOSPC;
+
+    for (uint32_t n = 0; n < SWAP_SLOTS; n++) {
+        uint32_t slot = (next_slot + n) % SWAP_SLOTS;
+        if (slot_map[slot / 32] & (1u << (slot % 32))) continue;
+
+        slot_map[slot / 32] |= 1u << (slot % 32);
+        slots_used++;
+        next_slot = slot + 1;
+        return slot;
+    }
+    return -ENOSPC;
+}
+
+void swap_free(uint32_t slot) {
+    if (slot >= SWAP_SLOTS || !(slot_map[slot / 32] & (1u << (slot % 32)))) {
+        printk("Invalid swap slot free: %d\n", slot);
+        return;
+    }
+    slot_map[slot / 32] &= ~(1u << (slot % 32));
+    slots_used--;
+}
+
+// a page is a few sectors, and with small clusters it can straddle two of them
+static int swap_io(uint32_t slot, uint8_t* page, int write) {
+    uint32_t sector_size = swap_fs->bytes_per_sector;
+    for (uint32_t off = 0; off < PAGE_SIZE; off += sector_size) {
+        uint32_t file_off = slot * PAGE_SIZE + off;
+        uint32_t sector = cluster_sector[file_off / swap_fs->cluster_size] + (file_off % swap_fs->cluster_size) / sector_size;
+
+        int err = write ? swap_fs->disk.write_sector(sector, page + off) : swap_fs->disk.read_sector(sector, page + off);
+        if (err) return -EIO;
+    }
+    return 0;
+}
+
+int swap_out(const void* page) {
+    if (!cluster_sector) return -ENOSPC;
+
+    int slot = slot_alloc();
+    if (slot < 0) return slot;
+
+    if (swap_io(slot, (uint8_t*)page, 1) != 0) {
+        swap_free(slot);
+        return -EIO;
+    }
+    return slot;
+}
+
+int swap_in(uint32_t slot, void* page) {
+    if (!cluster_sector || slot >= SWAP_SLOTS) return -EINVAL;
+    return swap_io(slot, page, 0);
+}
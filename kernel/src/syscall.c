@@ -16,17 +16,18 @@
 #include <kernel/time.h>
 #include <kernel/timer.h>
 #include <kernel/sleep.h>
+#include <kernel/mm.h>
 
 #define __user
 
 // we will use some macros later to clean up the warnings
 
 // here for now, later we can move this
-// copy len bytes to current_process dest from src
+// copy len bytes to current_process dest from src, -EFAULT if the range isn't all user memory.
+// pages that haven't been touched yet get faulted in by the memcpy, so check against the areas
 int copy_to_user(uint8_t* __user dest, const uint8_t* src, size_t len) {
-    if (!mmu_driver.is_user_addr((uint32_t) dest, len)) {
-        panic("failed tto check if user addr");
-        return -1;
+    if (!vma_range_ok(process_mm(current_process), (uint32_t) dest, len)) {
+        return -EFAULT;
     }
 
     // TODO: any other checks? we don't need to copy to kvirt memory, because of ttbr0/ttbr1
@@ -35,9 +36,8 @@ int copy_to_user(uint8_t* __user dest, const uint8_t* src, size_t len) {
 }
 
 int copy_from_user(uint8_t* dest, const uint8_t* __user src, size_t len) {
-    if (!mmu_driver.is_user_addr((uint32_t) src, len)) {
-        panic("failed to check if user addr");
-        return -1;
+    if (!vma_range_ok(process_mm(current_process), (uint32_t) src, len)) {
+        return -EFAULT;
     }
 
     memcpy(dest, src, len);
@@ -45,27 +45,118 @@ int copy_from_user(uint8_t* dest, const uint8_t* __user src, size_t len) {
 }
 
 DEFINE_SYSCALL0(fork) {
+    // a vfork child has no pages of its own to copy, it may only exec or exit
+    if (current_process->flags & PROCESS_FLAG_VFORK) return -EINVAL;
+
     process_t* child = create_process(NULL, current_process);
     if (!child) {
-        return -1;
+        return -EAGAIN; // process table is full (or out of memory)
     }
 
-    child->forked = 1;
-    child->stack_top[0] = 0; // return value of fork in child is 0
+    child->trapframe->r[0] = 0; // return value of fork in child is 0
     mmu_driver.set_l1_with_asid(current_process->ttbr0, current_process->asid);
 
     return child->pid; // return value of fork in parent is child's pid
 }
 END_SYSCALL
 
+// the child's fd table: a copy of ours with the file actions applied in order
+static int spawn_fd_table(struct fd_table* files, const struct spawn_fd_action* __user actions) {
+    struct spawn_fd_action act;
+    int err = fd_table_clone(files, &current_process->files);
+    if (err) return err;
+
+    for (int i = 0; actions; i++) {
+        if (i == SPAWN_FD_ACTIONS_MAX) {
+            err = -E2BIG;
+            break;
+        }
+
+        err = copy_from_user((uint8_t*)&act, (const uint8_t*)&actions[i], sizeof(act));
+        if (err) break;
+        if (act.action == SPAWN_FD_END) break;
+
+        if (act.action == SPAWN_FD_CLOSE) {
+            vfs_file_t* file = fd_remove(files, act.fd);
+            if (!file) {
+                err = -EBADF;
+                break;
+            }
+            vfs_file_put(file);
+        } else if (act.action == SPAWN_FD_DUP2) {
+            vfs_file_t* file = fd_lookup(files, act.src);
+            if (!file) {
+                err = -EBADF;
+                break;
+            }
+            if (act.src == act.fd) continue;
+
+            vfs_file_t* old = fd_remove(files, act.fd);
+            if (old) vfs_file_put(old);
+
+            err = fd_install_at(files, act.fd, file);
+            if (err < 0) break;
+            file->refcount++;
+            err = 0;
+        } else {
+            err = -EINVAL;
+            break;
+        }
+    }
+
+    if (err) fd_table_release(files);
+    return err;
+}
+
+// fork + exec in one go, the child is built straight from the ELF so none of our memory is
+// copied just to be thrown away. argv and envp aren't handed to the image yet, like exec
+DEFINE_SYSCALL4(spawn, const char*, path, char* const*, argv, char* const*, envp, const struct spawn_fd_action*, actions) {
+    if (!path) return -EINVAL;
+
+    binary_t* bin = load_binary(path);
+    if (IS_ERR(bin)) return PTR_ERR(bin);
+
+    struct fd_table files;
+    int err = spawn_fd_table(&files, actions);
+    if (err) {
+        free_binary(bin);
+        return err;
+    }
+
+    process_t* child = spawn_process(bin, current_process, &files);
+    free_binary(bin);
+    if (!child) {
+        fd_table_release(&files);
+        return -EAGAIN;
+    }
+
+    set_process_name(child, path); // it can't run before we leave the syscall
+    return child->pid;
+}
+END_SYSCALL
+
+// the child borrows our address space and we stay asleep until it has exec'd or exited,
+// so nothing gets copied. Like vfork anywhere else, the child may only call exec or exit
+DEFINE_SYSCALL0(vfork) {
+    if (current_process->flags & PROCESS_FLAG_VFORK) return -EINVAL;
+
+    process_t* child = vfork_process(current_process);
+    if (!child) return -EAGAIN;
+    child->trapframe->r[0] = 0;
+
+    // the child stays a zombie until we waitpid it, so it's safe to look at after it exits
+    while (child->flags & PROCESS_FLAG_VFORK) block_on(&current_process->child_wait);
+    return child->pid;
+}
+END_SYSCALL
+
 DEFINE_SYSCALL0(getpid) {
     return current_process->pid;
 }
 END_SYSCALL
 
 DEFINE_SYSCALL0(yield) {
-    scheduler_driver.schedule_next = 1;
-    current_process->state = PROCESS_READY;
+    scheduler_driver.schedule_next = 1; // goes to the back of the run queue on the way out
     return 0;
 }
 END_SYSCALL
@@ -75,6 +166,7 @@ DEFINE_SYSCALL2(open, const char*, path, int, flags) {
     if (!path) return -EINVAL;
 
     vfs_dentry_t *dentry = vfs_root_node->inode->ops->lookup(vfs_root_node, path);
+    if (!dentry) return -ENOENT;
 
     // if (!dentry) {
     //     if (!(flags & O_CREAT)) return -ENOENT; // no file and no create flag
@@ -91,23 +183,21 @@ DEFINE_SYSCALL2(open, const char*, path, int, flags) {
     if (IS_ERR(file)) {
         return PTR_ERR(file);
     }
-    for (int i = 0; i < MAX_FDS; i++) {
-        if (!current_process->fd_table[i]) {
-            current_process->fd_table[i] = file;
-            current_process->num_fds++;
-            LOG(INFO, "YES %d %d\n", i, current_process->pid);
-            return i;
-        }
-    }
 
-    return -EMFILE; // Too many open files
+    // lowest free fd, or -EMFILE once the table is at FD_MAX
+    int fd = fd_install(&current_process->files, file);
+    if (fd < 0) vfs_file_put(file);
+    return fd;
 }
 END_SYSCALL
 
 DEFINE_SYSCALL1(close, int, fd) {
-    int res = vfs_root_node->inode->ops->close(fd);
+    vfs_file_t* file = fd_remove(&current_process->files, fd);
+    if (!file) return -EBADF;
 
-    return res;
+    // the filesystem's close runs once the last fd sharing it is gone
+    vfs_file_put(file);
+    return 0;
 }
 END_SYSCALL
 
@@ -116,7 +206,7 @@ DEFINE_SYSCALL3(read, int, fd, char*, buff, size_t, count) {
         return -EINVAL; // Invalid arguments
     }
 
-    vfs_file_t* file = current_process->fd_table[fd];
+    vfs_file_t* file = fd_lookup(&current_process->files, fd);
     if (!file) {
         return -EBADF; // Bad file descriptor
     }
@@ -128,7 +218,7 @@ DEFINE_SYSCALL3(read, int, fd, char*, buff, size_t, count) {
     ssize_t bytes_read = file->dirent->inode->ops->read(file, buff, count);
 
     // update the offset
-    file->offset += bytes_read;
+    if (bytes_read > 0) file->offset += bytes_read;
 
     return bytes_read;
 }
@@ -139,7 +229,7 @@ DEFINE_SYSCALL3(write, int, fd, const char*, buff, size_t, count) {
         return -EINVAL; // Invalid arguments
     }
 
-    vfs_file_t* file = current_process->fd_table[fd];
+    vfs_file_t* file = fd_lookup(&current_process->files, fd);
     if (!file) {
         return -EBADF; // Bad file descriptor
     }
@@ -158,7 +248,7 @@ DEFINE_SYSCALL3(readdir, int, fd, struct dirent*, buf, size_t, len) {
         return -EINVAL; // Invalid arguments
     }
 
-    vfs_file_t* file = current_process->fd_table[fd];
+    vfs_file_t* file = fd_lookup(&current_process->files, fd);
     if (!file) {
         return -EBADF; // Bad file descriptor
     }
@@ -178,34 +268,18 @@ END_SYSCALL
 
 DEFINE_SYSCALL1(exec, char*, path) {
     if (!path) return -EINVAL;
-    // check that path is valid
 
-    vfs_dentry_t* dentry = vfs_root_node->inode->ops->lookup(vfs_root_node, path);
-    if (!dentry) {
-        return -ENOENT; // No such file or directory
+    binary_t* bin = load_binary(path);
+    if (IS_ERR(bin)) {
+        return PTR_ERR(bin);
     }
 
-    uint8_t* buffer = (uint8_t*) kmalloc(dentry->inode->size);
-    if (!buffer) {
-        return -ENOMEM; // Out of memory
-    }
-
-    vfs_file_t* file = dentry->inode->ops->open(dentry, 0);
-    if (IS_ERR(file)) {
-        return PTR_ERR(file);
-    }
-
-    if (dentry->inode->ops->read(file, buffer, dentry->inode->size)
-        != (ssize_t)dentry->inode->size) {
-            return -EIO; // I/O error
-    }
-
-    kfree(file);
-    binary_t* bin = load_elf32(buffer, dentry->inode->size);
-
-    if (swap_process(bin, current_process) != 0) { // might need to propagate error
+    int res = swap_process(bin, current_process);
+    free_binary(bin);
+    if (res != 0) { // might need to propagate error
         return -ENOMEM; // Out of memory
     }
+    set_process_name(current_process, path);
 
     return 0;
 }
@@ -221,26 +295,9 @@ DEFINE_SYSCALL2(debug, const char*, buf, int, len) {
 }
 END_SYSCALL
 
-// should put exit status in process and not fully free the process, just the memory and mark process as dead
+// everything but the exit status is freed now, waitpid reaps the rest
 DEFINE_SYSCALL1(exit, int, exit_status) {
-    // iterate through all pages and free them if they are not shared, otherwise decrement the ref count
-    free_process_memory(current_process);
-    free_aligned_pages(&kpage_allocator, current_process->ttbr0, 4);
-
-    // wake up a waiting parent and set the exit status
-    if (current_process->waiting_parent) {
-        current_process->waiting_parent->state = PROCESS_READY;
-        current_process->waiting_parent->stack_top[0] = exit_status; // r0
-        LOG(INFO, "Parent should get return value %d\n", exit_status);
-    }
-
-    current_process->state = PROCESS_KILLED;
-    current_process->exit_status = exit_status;
-    current_process = NULL;
-    scheduler_driver.schedule_next = 1;
-
-
-    return 0;
+    process_exit(exit_status);
 }
 END_SYSCALL
 
@@ -266,17 +323,7 @@ END_SYSCALL
 DEFINE_SYSCALL2(usleep, uint32_t, us_high, uint32_t, us_low) {
     uint64_t us = ((uint64_t) us_high << 32) | (uint64_t) us_low;
 
-    current_process->wake_ticks = clock_timer.get_ticks() + clock_timer.us_to_ticks(us);
-    current_process->state = PROCESS_SLEEPING;
-
-    if (sleep_queue.count < MAX_PROCESSES) {
-        sleep_queue.procs[sleep_queue.count++] = current_process;
-    } else {
-        // this should never be able to happen
-        panic("Unable to sleep! sleep_queue.count > MAX_PROCESSES!\n");
-    }
-
-    scheduler_driver.schedule_next = 1;
+    sleep_until(clock_timer.get_ticks() + clock_timer.us_to_ticks(us));
     return 0;
 }
 END_SYSCALL
@@ -285,7 +332,7 @@ DEFINE_SYSCALL3(lseek, int, fd, off_t, offset, int, when) {
     if (fd < 0) return -EBADF; // bad file descriptor
     if (when < 0 || when > 2) return -EINVAL; // invalid whence
 
-    vfs_file_t* file = current_process->fd_table[fd];
+    vfs_file_t* file = fd_lookup(&current_process->files, fd);
     if (!file) return -EBADF; // bad file descriptor
 
     // verify that the offset is valid
@@ -314,16 +361,15 @@ DEFINE_SYSCALL1(waitpid, int32_t, pid) {
     if (!target) return -ECHILD; // no child processes
     if (target->ppid != current_process->pid) return -ECHILD; // not a child process
 
-    // add process to target
-    target->waiting_parent = current_process;
+    // sleep until child process is done, it may already be. The flag keeps an orphan from
+    // freeing itself on exit while we hold a pointer to it
+    target->flags |= PROCESS_FLAG_WAITED;
+    while (target->state != PROCESS_KILLED) block_on(&current_process->child_wait);
 
-    // sleep until child process is done
-    current_process->state = PROCESS_BLOCKED;
-    current_process = NULL;
-    scheduler_driver.schedule_next = 1;
-
-    // this value is not returned to the parent process
-    return 0;
+    // reap it, the process_t and pid are free from here
+    int32_t status = target->exit_status;
+    release_process(target);
+    return status;
 }
 END_SYSCALL
 
@@ -332,6 +378,53 @@ DEFINE_SYSCALL3(execve, const char*, path, char** const, argv, char const**, env
 }
 END_SYSCALL
 
+DEFINE_SYSCALL3(ioctl, int, fd, uint32_t, cmd, uint32_t, arg) {
+    vfs_file_t* file = fd_lookup(&current_process->files, fd);
+    if (!file) return -EBADF;
+
+    if (!file->dirent->inode || !file->dirent->inode->ops || !file->dirent->inode->ops->ioctl) {
+        return -ENOTTY; // not a device that takes control calls
+    }
+
+    return file->dirent->inode->ops->ioctl(file, cmd, arg);
+}
+END_SYSCALL
+
+// the current break for 0 or anything brk can't move to, the new one otherwise
+DEFINE_SYSCALL1(brk, uint32_t, addr) {
+    process_t* p = current_process;
+    if (p->flags & PROCESS_FLAG_VFORK) return -EINVAL; // the heap belongs to the parent
+
+    uint32_t old_brk = p->mm.brk;
+    if (addr && mm_brk(&p->mm, p->ttbr0, addr) == 0 && addr < old_brk) flush_asid(p->asid);
+    return p->mm.brk;
+}
+END_SYSCALL
+
+// anonymous memory only, pages are faulted in on first touch
+DEFINE_SYSCALL4(mmap, uint32_t, addr, size_t, len, uint32_t, prot, uint32_t, flags) {
+    process_t* p = current_process;
+    if (p->flags & PROCESS_FLAG_VFORK) return -EINVAL;
+
+    struct vm_area* vma = mm_mmap(&p->mm, p->ttbr0, addr, len, prot, flags);
+    if (IS_ERR(vma)) return PTR_ERR(vma);
+
+    if (flags & MAP_FIXED) flush_asid(p->asid); // may have replaced something
+    return vma->start;
+}
+END_SYSCALL
+
+DEFINE_SYSCALL2(munmap, uint32_t, addr, size_t, len) {
+    process_t* p = current_process;
+    if (p->flags & PROCESS_FLAG_VFORK) return -EINVAL;
+    if (!len || len > KERNEL_DIVIDER) return -EINVAL;
+
+    int err = vma_unmap(&p->mm, p->ttbr0, addr, addr + PAGE_ALIGN(len));
+    flush_asid(p->asid);
+    return err;
+}
+END_SYSCALL
+
 const syscall_entry_t syscall_table[NR_SYSCALLS + 1] = {
     [SYS_DEBUG]        = {{.fn2 = sys_debug},          "debug",        2},
     [SYS_EXIT]         = {{.fn1 = sys_exit},           "exit",         1},
@@ -350,6 +443,12 @@ const syscall_entry_t syscall_table[NR_SYSCALLS + 1] = {
     [SYS_LSEEK]        = {{.fn3 = sys_lseek},          "lseek",        3},
     [SYS_WAITPID]      = {{.fn1 = sys_waitpid},      "waitpid",        1},
     [SYS_EXECVE]       = {{.fn3 = sys_execve},        "execve",        3},
+    [SYS_IOCTL]        = {{.fn3 = sys_ioctl},          "ioctl",        3},
+    [SYS_SPAWN]        = {{.fn4 = sys_spawn},          "spawn",        4},
+    [SYS_VFORK]        = {{.fn0 = sys_vfork},          "vfork",        0},
+    [SYS_BRK]          = {{.fn1 = sys_brk},            "brk",          1},
+    [SYS_MMAP]         = {{.fn4 = sys_mmap},           "mmap",         4},
+    [SYS_MUNMAP]       = {{.fn2 = sys_munmap},         "munmap",       2},
 };
 
 
@@ -365,10 +464,9 @@ int handle_syscall(int num, int arg1, int arg2, int arg3, int arg4) {
         }
     }
 
-    // if exec, then we don't need to set the return value in the process
-    if (num == SYS_EXEC) return ret;
+    // a successful exec already set up the registers of the new image
+    if (num == SYS_EXEC && ret == 0) return ret;
 
-    // process doesn't necessarily exist as runnable anymore, so check for it first
-    if (current_process) current_process->stack_top[0] = ret;
+    current_process->trapframe->r[0] = ret;
     return ret;
 }
@@ -55,12 +55,27 @@ unsigned int REG32_read_masked(unsigned int base, unsigned int offset, unsigned
 // here for now
 //
 
+// word at a time helpers, a word has a zero byte if any byte borrows when 1 is subtracted
+// and it didn't already have its top bit set. aligned loads never cross a page, so reading
+// a few bytes past the terminator is safe
+#define ONES  0x01010101U
+#define HIGHS 0x80808080U
+#define HAS_ZERO(v) (((v) - ONES) & ~(v) & HIGHS)
+#define WORD_ALIGNED(p) (((uintptr_t)(p) & 3) == 0)
+
 unsigned int strlen(const char* str) {
-    unsigned int len = 0;
-    while (*str != '\0') {
-        len++;str++;
+    const char* s = str;
+    while (!WORD_ALIGNED(s)) {
+        if (*s == '\0') return s - str;
+        s++;
     }
-    return len;
+
+    const uint32_t* w = (const uint32_t*)s;
+    while (!HAS_ZERO(*w)) w++;
+
+    s = (const char*)w;
+    while (*s) s++;
+    return s - str;
 }
 
 char* strcpy(char* dest, const char* src) {
@@ -87,20 +102,27 @@ char* strncpy(char* dest, const char* src, unsigned int n) {
 }
 
 char* strchr(const char* str, int c) {
-    while (*str != '\0') {
-        if (*str == c) {
-            return (char*)str;
-        }
+    char ch = (char)c;
+    while (!WORD_ALIGNED(str)) {
+        if (*str == ch) return (char*)str;
+        if (*str == '\0') return NULL;
         str++;
     }
-    if (c == '\0') {  // Handle null terminator case
-        return (char*)str;
+
+    // stop at the first word holding either the terminator or c
+    uint32_t mask = (uint8_t)ch * ONES;
+    const uint32_t* w = (const uint32_t*)str;
+    while (!HAS_ZERO(*w) && !HAS_ZERO(*w ^ mask)) w++;
+
+    for (str = (const char*)w; ; str++) {
+        if (*str == ch) return (char*)str;
+        if (*str == '\0') return NULL;
     }
-    return NULL;
 }
 
 char* strtok(char* str, const char* delim) {
     static char* buffer = NULL;
+    uint32_t delims[8] = {0}; // one bit per byte value, instead of a strchr per character
 
     // Handle initial case or explicit new string
     if (str != NULL) {
@@ -112,8 +134,11 @@ char* strtok(char* str, const char* delim) {
         return NULL;
     }
 
+    for (; *delim; delim++) delims[(uint8_t)*delim >> 5] |= 1U << (*delim & 31);
+#define IS_DELIM(c) (delims[(uint8_t)(c) >> 5] & (1U << ((c) & 31)))
+
     // Skip leading delimiters
-    while (*buffer && strchr(delim, *buffer) != NULL) {
+    while (*buffer && IS_DELIM(*buffer)) {
         buffer++;
     }
 
@@ -126,9 +151,10 @@ char* strtok(char* str, const char* delim) {
     char* start = buffer;
 
     // Find end of token
-    while (*buffer && strchr(delim, *buffer) == NULL) {
+    while (*buffer && !IS_DELIM(*buffer)) {
         buffer++;
     }
+#undef IS_DELIM
 
     if (*buffer) {
         *buffer = '\0';
@@ -145,49 +171,152 @@ int toupper(int c) {
     return c;
 }
 
+// The mem* functions below run under both the bootloader and the kernel, so they stick to
+// plain ARM LDM/STM bursts (8 registers, 32 bytes at a time). NEON is only used for whole
+// pages, see clear_page/copy_page in asm/page.S.
+#define MEM_BURST 32
+
 void* memset(void* ptr, int value, unsigned long num) {
-    unsigned char* p = (unsigned char*)ptr;
-    while (num > 0) {
-        *p = (unsigned char)value;
-        p++;
+    uint8_t* p = (uint8_t*)ptr;
+    uint8_t byte = (uint8_t)value;
+
+    // not worth aligning for tiny sets
+    if (num < MEM_BURST) {
+        while (num--) *p++ = byte;
+        return ptr;
+    }
+
+    while ((uintptr_t)p & 3) {
+        *p++ = byte;
         num--;
     }
-    return ptr;
 
-}
+    uint32_t pattern = byte * 0x01010101U;
+    uint32_t blocks = num / MEM_BURST;
+    if (blocks) {
+#ifdef __arm__
+        __asm__ volatile(
+            "mov r3, %2\n\t"
+            "mov r4, %2\n\t"
+            "mov r5, %2\n\t"
+            "mov r6, %2\n\t"
+            "mov r7, %2\n\t"
+            "mov r8, %2\n\t"
+            "mov r9, %2\n\t"
+            "mov r10, %2\n"
+            "1:\n\t"
+            "stmia %0!, {r3-r10}\n\t"
+            "subs %1, %1, #1\n\t"
+            "bne 1b\n\t"
+            : "+r"(p), "+r"(blocks)
+            : "r"(pattern)
+            : "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "cc", "memory");
+#else
+        // host builds (tests/) take the same path with plain word stores
+        for (uint32_t* w = (uint32_t*)p; blocks--; w += MEM_BURST / 4) {
+            for (int i = 0; i < MEM_BURST / 4; i++) w[i] = pattern;
+        }
+        p += (num / MEM_BURST) * MEM_BURST;
+#endif
+        num %= MEM_BURST;
+    }
 
-// void* memcpy(void* dest, const void* src, unsigned long size) {
-//     char* d = (char*)dest;
-//     const char* s = (const char*)src;
-//     while (size > 0) {
-//         *d = *s;
-//         d++;
-//         s++;
-//         size--;
-//     }
-//     return dest;
-// }
+    uint32_t* w = (uint32_t*)p;
+    while (num >= 4) {
+        *w++ = pattern;
+        num -= 4;
+    }
+
+    p = (uint8_t*)w;
+    while (num--) *p++ = byte;
+    return ptr;
+}
 
+// Copies forwards only, memmove relies on that when dest is below src
 void* memcpy(void* dest, const void* src, unsigned long size) {
-    char* d = (char*)dest;
-    const char* s = (const char*)src;
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
 
-    // Copy in 4-byte chunks
-    while (size >= 4) {
-        *(int*)d = *(const int*)s;
-        d += 4;
-        s += 4;
-        size -= 4;
+    if (size < MEM_BURST) {
+        while (size--) *d++ = *s++;
+        return dest;
     }
 
-    // Copy any remaining bytes one-by-one
-    while (size > 0) {
-        *d = *s;
-        d++;
-        s++;
+    // align the destination, stores are the expensive side
+    while ((uintptr_t)d & 3) {
+        *d++ = *s++;
         size--;
     }
 
+    if (((uintptr_t)s & 3) == 0) {
+        uint32_t blocks = size / MEM_BURST;
+        if (blocks) {
+#ifdef __arm__
+            __asm__ volatile(
+                "1:\n\t"
+                "pld [%1, #64]\n\t"
+                "ldmia %1!, {r3-r10}\n\t"
+                "stmia %0!, {r3-r10}\n\t"
+                "subs %2, %2, #1\n\t"
+                "bne 1b\n\t"
+                : "+r"(d), "+r"(s), "+r"(blocks)
+                :
+                : "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "cc", "memory");
+#else
+            for (; blocks--; d += MEM_BURST, s += MEM_BURST) {
+                for (int i = 0; i < MEM_BURST / 4; i++) ((uint32_t*)d)[i] = ((const uint32_t*)s)[i];
+            }
+#endif
+            size %= MEM_BURST;
+        }
+
+        while (size >= 4) {
+            *(uint32_t*)d = *(const uint32_t*)s;
+            d += 4;
+            s += 4;
+            size -= 4;
+        }
+    } else {
+        // src is off by 1-3 bytes, load aligned words and stitch neighbours together
+        uint32_t shift = ((uintptr_t)s & 3) * 8;
+        const uint32_t* ws = (const uint32_t*)((uintptr_t)s & ~3);
+        uint32_t* wd = (uint32_t*)d;
+        uint32_t cur = *ws++;
+        uint32_t words = size / 4;
+
+        for (uint32_t i = 0; i < words; i++) {
+            uint32_t next = *ws++;
+            *wd++ = (cur >> shift) | (next << (32 - shift));
+            cur = next;
+        }
+
+        d += words * 4;
+        s += words * 4;
+        size %= 4;
+    }
+
+    while (size--) *d++ = *s++;
+    return dest;
+}
+
+void* memmove(void* dest, const void* src, unsigned long size) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+
+    if (d <= s || d >= s + size) return memcpy(dest, src, size);
+
+    // overlapping with dest above src, go backwards
+    d += size;
+    s += size;
+    if ((((uintptr_t)d | (uintptr_t)s) & 3) == 0) {
+        while (size >= 4) {
+            d -= 4;
+            s -= 4;
+            *(uint32_t*)d = *(const uint32_t*)s;
+            size -= 4;
+        }
+    }
+    while (size--) *--d = *--s;
     return dest;
 }
 
@@ -205,37 +334,135 @@ int memcmp(const void* ptr1, const void* ptr2, unsigned long num) {
     return 0;
 }
 
+/**
+ * Checksum a block of memory with xxHash32 (seed 0)
+ *
+ * This is the same hash LZ4 frames use for their content checksum, so the bootloader
+ * can check a decompressed kernel against the frame without hashing it twice.
+ *
+ * @param data   Data to checksum
+ * @param len    Length of the data in bytes
+ * @return       32-bit hash of the data
+ */
+#define XXH_PRIME32_1 0x9E3779B1U
+#define XXH_PRIME32_2 0x85EBCA77U
+#define XXH_PRIME32_3 0xC2B2AE3DU
+#define XXH_PRIME32_4 0x27D4EB2FU
+#define XXH_PRIME32_5 0x165667B1U
+#define XXH_ROTL32(x, r) (((x) << (r)) | ((x) >> (32 - (r))))
+
+static inline uint32_t xxh_read32(const uint8_t* p) {
+    if (((uintptr_t)p & 3) == 0) return *(const uint32_t*)p;
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t xxh_round(uint32_t acc, uint32_t input) {
+    acc += input * XXH_PRIME32_2;
+    acc = XXH_ROTL32(acc, 13);
+    return acc * XXH_PRIME32_1;
+}
+
 uint32_t calculate_checksum(const void *data, size_t len) {
-    uint32_t checksum = 0;
-    const uint8_t *ptr = (const uint8_t*)data;
+    const uint8_t *p = (const uint8_t*)data;
+    const uint8_t *end = p + len;
+    uint32_t h;
+
+    if (len >= 16) {
+        const uint8_t *limit = end - 16;
+        uint32_t v1 = XXH_PRIME32_1 + XXH_PRIME32_2;
+        uint32_t v2 = XXH_PRIME32_2;
+        uint32_t v3 = 0;
+        uint32_t v4 = 0 - XXH_PRIME32_1;
+
+        do {
+            v1 = xxh_round(v1, xxh_read32(p));
+            v2 = xxh_round(v2, xxh_read32(p + 4));
+            v3 = xxh_round(v3, xxh_read32(p + 8));
+            v4 = xxh_round(v4, xxh_read32(p + 12));
+            p += 16;
+        } while (p <= limit);
+
+        h = XXH_ROTL32(v1, 1) + XXH_ROTL32(v2, 7) + XXH_ROTL32(v3, 12) + XXH_ROTL32(v4, 18);
+    } else {
+        h = XXH_PRIME32_5;
+    }
 
-    for (size_t i = 0; i < len; i++) {
-        checksum ^= ptr[i];
+    h += (uint32_t)len;
+
+    while (p + 4 <= end) {
+        h += xxh_read32(p) * XXH_PRIME32_3;
+        h = XXH_ROTL32(h, 17) * XXH_PRIME32_4;
+        p += 4;
+    }
+
+    while (p < end) {
+        h += (*p) * XXH_PRIME32_5;
+        h = XXH_ROTL32(h, 11) * XXH_PRIME32_1;
+        p++;
     }
-    return checksum;
+
+    h ^= h >> 15;
+    h *= XXH_PRIME32_2;
+    h ^= h >> 13;
+    h *= XXH_PRIME32_3;
+    h ^= h >> 16;
+    return h;
 }
 
 int strcmp(const char* str1, const char* str2) {
-    while (*str1 != '\0' && *str2 != '\0') {
-        if (*str1 != *str2) {
-            return *str1 - *str2;
+    // words only line up when both strings share an alignment
+    if (((uintptr_t)str1 & 3) == ((uintptr_t)str2 & 3)) {
+        while (!WORD_ALIGNED(str1)) {
+            if (*str1 != *str2 || *str1 == '\0') goto bytes;
+            str1++;
+            str2++;
+        }
+
+        const uint32_t* w1 = (const uint32_t*)str1;
+        const uint32_t* w2 = (const uint32_t*)str2;
+        while (*w1 == *w2 && !HAS_ZERO(*w1)) {
+            w1++;
+            w2++;
         }
+        str1 = (const char*)w1;
+        str2 = (const char*)w2;
+    }
+
+bytes:
+    while (*str1 != '\0' && *str1 == *str2) {
         str1++;
         str2++;
     }
-    return *str1 - *str2;
+    return (uint8_t)*str1 - (uint8_t)*str2;
 }
 
 int strncmp(const char* str1, const char* str2, unsigned int n) {
-    while (*str1 != '\0' && *str2 != '\0' && n > 0) {
-        if (*str1 != *str2) {
-            return *str1 - *str2;
+    if (((uintptr_t)str1 & 3) == ((uintptr_t)str2 & 3)) {
+        while (n && !WORD_ALIGNED(str1)) {
+            if (*str1 != *str2 || *str1 == '\0') goto bytes;
+            str1++;
+            str2++;
+            n--;
+        }
+
+        const uint32_t* w1 = (const uint32_t*)str1;
+        const uint32_t* w2 = (const uint32_t*)str2;
+        while (n >= 4 && *w1 == *w2 && !HAS_ZERO(*w1)) {
+            w1++;
+            w2++;
+            n -= 4;
         }
+        str1 = (const char*)w1;
+        str2 = (const char*)w2;
+    }
+
+bytes:
+    while (n && *str1 != '\0' && *str1 == *str2) {
         str1++;
         str2++;
         n--;
     }
-    return 0;
+    return n ? (uint8_t)*str1 - (uint8_t)*str2 : 0;
 }
 
 char* strcat(char* dest, const char* src) {
@@ -0,0 +1,128 @@
+#include <kernel/file.h>
+#include <kernel/vfs.h>
+#include <kernel/heap.h>
+#include <kernel/errno.h>
+#include <kernel/string.h>
+
+#define FD_BITMAP_WORDS(size) (((size) + 31) / 32)
+
+static int fd_table_alloc(struct fd_table* t, uint32_t size) {
+    t->files = kmalloc(size * sizeof(*t->files));
+    t->open = kmalloc(FD_BITMAP_WORDS(size) * sizeof(uint32_t));
+    if (!t->files || !t->open) {
+        kfree(t->files);
+        kfree(t->open);
+        return -ENOMEM;
+    }
+
+    memset(t->files, 0, size * sizeof(*t->files));
+    memset(t->open, 0, FD_BITMAP_WORDS(size) * sizeof(uint32_t));
+    t->size = size;
+    t->count = 0;
+    return 0;
+}
+
+int fd_table_init(struct fd_table* t) {
+    return fd_table_alloc(t, FD_TABLE_INITIAL);
+}
+
+int fd_table_clone(struct fd_table* t, const struct fd_table* parent) {
+    if (fd_table_alloc(t, parent->size) != 0) return -ENOMEM;
+
+    memcpy(t->files, parent->files, parent->size * sizeof(*t->files));
+    memcpy(t->open, parent->open, FD_BITMAP_WORDS(parent->size) * sizeof(uint32_t));
+    t->count = parent->count;
+
+    for (uint32_t fd = 0; fd < t->size; fd++) {
+        if (t->files[fd]) t->files[fd]->refcount++;
+    }
+    return 0;
+}
+
+void fd_table_release(struct fd_table* t) {
+    for (uint32_t fd = 0; fd < t->size; fd++) {
+        if (t->files[fd]) vfs_file_put(t->files[fd]);
+    }
+
+    kfree(t->files);
+    kfree(t->open);
+    t->files = NULL;
+    t->open = NULL;
+    t->size = 0;
+    t->count = 0;
+}
+
+// double the table, existing fds keep their numbers
+static int fd_table_grow(struct fd_table* t) {
+    uint32_t size = t->size ? t->size * 2 : FD_TABLE_INITIAL;
+    if (size > FD_MAX) size = FD_MAX;
+    if (size <= t->size) return -EMFILE;
+
+    struct fd_table bigger;
+    if (fd_table_alloc(&bigger, size) != 0) return -ENOMEM;
+
+    if (t->size) {
+        memcpy(bigger.files, t->files, t->size * sizeof(*t->files));
+        memcpy(bigger.open, t->open, FD_BITMAP_WORDS(t->size) * sizeof(uint32_t));
+    }
+    bigger.count = t->count;
+
+    kfree(t->files);
+    kfree(t->open);
+    *t = bigger;
+    return 0;
+}
+
+static int fd_lowest_free(const struct fd_table* t) {
+    for (uint32_t w = 0; w < FD_BITMAP_WORDS(t->size); w++) {
+        if (t->open[w] == 0xFFFFFFFF) continue;
+
+        uint32_t fd = w * 32 + __builtin_ctz(~t->open[w]);
+        return fd < t->size ? (int)fd : -1;
+    }
+    return -1;
+}
+
+int fd_install(struct fd_table* t, struct file* file) {
+    int fd = fd_lowest_free(t);
+    if (fd < 0) {
+        int err = fd_table_grow(t);
+        if (err) return err;
+        fd = fd_lowest_free(t);
+    }
+
+    t->files[fd] = file;
+    t->open[fd / 32] |= 1u << (fd % 32);
+    t->count++;
+    return fd;
+}
+
+int fd_install_at(struct fd_table* t, int fd, struct file* file) {
+    if (fd < 0 || fd >= FD_MAX) return -EBADF;
+    if (fd_lookup(t, fd)) return -EEXIST;
+
+    while ((uint32_t)fd >= t->size) {
+        int err = fd_table_grow(t);
+        if (err) return err;
+    }
+
+    t->files[fd] = file;
+    t->open[fd / 32] |= 1u << (fd % 32);
+    t->count++;
+    return fd;
+}
+
+struct file* fd_lookup(const struct fd_table* t, int fd) {
+    if (fd < 0 || (uint32_t)fd >= t->size) return NULL;
+    return t->files[fd];
+}
+
+struct file* fd_remove(struct fd_table* t, int fd) {
+    struct file* file = fd_lookup(t, fd);
+    if (!file) return NULL;
+
+    t->files[fd] = NULL;
+    t->open[fd / 32] &= ~(1u << (fd % 32));
+    t->count--;
+    return file;
+}
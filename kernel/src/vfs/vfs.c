@@ -70,8 +70,11 @@ vfs_file_t* vfs_default_open(vfs_dentry_t* entry, int flags) {
         file->dirent = entry;
     }
 
+    file->dir_pos = NULL;
     file->offset = 0;
     file->flags = flags; // TODO - flags should be handled
+    file->refcount = 1;
+    file->private_data = NULL;
     return file;
     // TODO - handle freed-up file descriptors
     // current_process->fd_table[current_process->num_fds] = file;
@@ -79,15 +82,18 @@ vfs_file_t* vfs_default_open(vfs_dentry_t* entry, int flags) {
     // return current_process->num_fds++;
 }
 
-int vfs_default_close(int fd) {
-    if (fd < 0 || fd >= current_process->num_fds) {
-        return -EINVAL;
-    }
+// drop one reference, forked processes share the file until the last one closes it
+void vfs_file_put(vfs_file_t* file) {
+    if (--file->refcount) return;
 
-    kfree(current_process->fd_table[fd]);
-    current_process->fd_table[fd] = NULL;
+    vfs_ops_t* ops = file->dirent->inode->ops;
+    if (ops && ops->close) ops->close(file);
+    kfree(file);
+}
 
-    current_process->num_fds--;
+// nothing beyond the vfs_file_t itself, which vfs_file_put frees
+int vfs_default_close(vfs_file_t* file) {
+    (void)file;
     return 0;
 }
 
@@ -125,15 +131,28 @@ int vfs_default_readdir(vfs_file_t* file, dirent_t* buffer, size_t max_entries)
 }
 
 
-// Find a child node by name in a directory
-vfs_dentry_t* vfs_find_child(vfs_dentry_t* dir, const char* name) {
-    if (!dir || !S_ISDIR(dir->inode)) {
+// Split the next component off a path: skips slashes, points *name at the component and
+// returns its length (0 once the path is used up), leaving *path just past it. No copies.
+static size_t vfs_path_next(const char** path, const char** name) {
+    const char* p = *path;
+    while (*p == '/') p++;
+
+    *name = p;
+    while (*p != '/' && *p != '\0') p++;
+
+    *path = p;
+    return p - *name;
+}
+
+// Find a child node by a name that isn't necessarily terminated (a path component)
+static vfs_dentry_t* vfs_find_child_len(vfs_dentry_t* dir, const char* name, size_t len) {
+    if (!dir || !S_ISDIR(dir->inode) || len >= VFS_MAX_FILELEN) {
         return NULL;
     }
 
     vfs_dentry_t* child = dir->first_child;
     while (child != NULL) {
-        if (strcmp(child->name, name) == 0) {
+        if (strncmp(child->name, name, len) == 0 && child->name[len] == '\0') {
             return child;
         }
         child = child->next_sibling;
@@ -142,32 +161,23 @@ vfs_dentry_t* vfs_find_child(vfs_dentry_t* dir, const char* name) {
     return NULL;
 }
 
+// Find a child node by name in a directory
+vfs_dentry_t* vfs_find_child(vfs_dentry_t* dir, const char* name) {
+    return vfs_find_child_len(dir, name, strlen(name));
+}
+
 vfs_dentry_t* vfs_default_lookup(vfs_dentry_t* entry, const char* path) {
     if (!path || path[0] != '/') {
         return NULL; // Handle absolute paths only for simplicity
     }
 
     vfs_dentry_t* current = entry;
-    const char* current_pos = path;
-
-    // Skip leading '/'
-    current_pos++;
-
-    while (*current_pos != '\0') {
-        // Extract the next path component (e.g., "mnt", "fs", "file.txt")
-        const char* component_end = current_pos;
-        while (*component_end != '/' && *component_end != '\0') {
-            component_end++;
-        }
-        size_t component_len = component_end - current_pos;
-
-        // Copy the component into a buffer (e.g., "mnt")
-        char component[VFS_MAX_FILELEN + 1];
-        strncpy(component, current_pos, component_len);
-        component[component_len] = '\0';
+    const char* component;
+    size_t component_len;
 
+    while ((component_len = vfs_path_next(&path, &component))) {
         // Find the child dentry for this component
-        current = vfs_find_child(current, component);
+        current = vfs_find_child_len(current, component, component_len);
         if (!current) {
             return NULL; // Component not found
         }
@@ -175,7 +185,7 @@ vfs_dentry_t* vfs_default_lookup(vfs_dentry_t* entry, const char* path) {
         // Check if this dentry is a mount point
         if (current->mount) {
             // Calculate the remaining path after this component (e.g., "/file.txt" → "file.txt")
-            const char* remaining_path = component_end;
+            const char* remaining_path = path;
             while (*remaining_path == '/') {
                 remaining_path++; // Skip slashes
             }
@@ -185,12 +195,6 @@ vfs_dentry_t* vfs_default_lookup(vfs_dentry_t* entry, const char* path) {
             // Delegate lookup to the mounted filesystem's root
             return current->mount->root->inode->ops->lookup(current->mount->root, remaining_path);
         }
-
-        // Advance to the next component
-        current_pos = component_end;
-        while (*current_pos == '/') {
-            current_pos++; // Skip slashes between components
-        }
     }
 
     return current; // Final dentry after traversal
@@ -214,6 +218,7 @@ vfs_dentry_t* vfs_create_dirent(const char* name, uint32_t mode) {
     vfs_dentry_t* dentry = (vfs_dentry_t*)kmalloc(sizeof(vfs_dentry_t));
     if (!dentry) return NULL;
 
+    memset(dentry, 0, sizeof(vfs_dentry_t));
     strncpy(dentry->name, name, sizeof(dentry->name) - 1);
     dentry->inode = node;
     node->mode = mode;
@@ -371,7 +376,11 @@ void vfs_init(void) {
     zero_device_init();
     ones_device_init();
     uart0_vfs_device_init();
+    tty_device_init();
+    boottime_device_init();
+    ps_device_init();
     init_mount_fat32();
+    initramfs_init();
     enable_interrupts();
 }
 
@@ -397,16 +406,13 @@ vfs_dentry_t* vfs_finddir(const char* path) {
     }
 
     vfs_dentry_t* current = vfs_root_node;
-    char* path_copy = strdup(path);
-    char* token = strtok(path_copy, "/");
-    while (token) {
-        current = vfs_find_child(current, token);
-        if (!current) {
-            break;
-        }
-        token = strtok(NULL, "/");
+    const char* component;
+    size_t len;
+
+    // walk the path in place, lookups never touch the heap
+    while (current && (len = vfs_path_next(&path, &component))) {
+        current = vfs_find_child_len(current, component, len);
     }
-    kfree(path_copy);
     return current;
 }
 
@@ -0,0 +1,46 @@
+#include <kernel/vfs.h>
+#include <kernel/boottime.h>
+#include <kernel/errno.h>
+#include <kernel/string.h>
+#include <kernel/panic.h>
+
+#define BOOTTIME_BUFFER_SIZE 1024
+
+// the table is rendered fresh on every read, phases after vfs_init show up once they've run
+static ssize_t boottime_read(vfs_file_t* file, void* buffer, size_t count) {
+    char table[BOOTTIME_BUFFER_SIZE];
+    int len = boot_stamps_format(table, sizeof(table));
+
+    if (file->offset >= len) return 0;
+    if (count > (size_t)(len - file->offset)) count = len - file->offset;
+
+    memcpy(buffer, table + file->offset, count);
+    return count;
+}
+
+static ssize_t boottime_write(vfs_file_t* file, const void* buffer, size_t count) {
+    (void)file, (void)buffer, (void)count;
+    return -EROFS;
+}
+
+static vfs_ops_t boottime_ops = {
+    .read = boottime_read,
+    .write = boottime_write,
+    .open = vfs_default_open,
+    .close = vfs_default_close,
+    .readdir = NULL,
+    .lookup = NULL,
+};
+
+int boottime_device_init(void) {
+    vfs_dentry_t* dentry = vfs_create_dirent("boottime", VFS_CHR | S_IRUSR);
+    if (!dentry) return -ENOMEM;
+    dentry->inode->ops = &boottime_ops;
+
+    vfs_dentry_t* dev_directory = vfs_finddir("/dev");
+    if (!dev_directory) panic("Failed to find /dev directory when loading critical device!");
+    vfs_add_child(dev_directory, dentry);
+
+    LOG(INFO, "Mounted virtual char device 'boottime' at /dev/boottime\n");
+    return 0;
+}
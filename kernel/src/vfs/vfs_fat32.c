@@ -11,6 +11,7 @@
 #include <kernel/mmc.h>
 #include <kernel/file.h>
 #include <kernel/string.h>
+#include <kernel/swap.h>
 
 #define FAT32_ATTR_READ_ONLY 0x01
 #define FAT32_ATTR_HIDDEN 0x02
@@ -120,6 +121,7 @@ static vfs_file_t* fat32_vfs_open(vfs_dentry_t* dirent, int flags) {
 
     // FOR NOW, we are reading /mnt (/) so lets just do that.
     if (fat32_open(inode_private->fs, "/elf", file) != 0) {
+        kfree(file);
         return ERR_PTR(-1);
     }
 
@@ -130,8 +132,10 @@ static vfs_file_t* fat32_vfs_open(vfs_dentry_t* dirent, int flags) {
 
     vfs_file->private_data = file;
     vfs_file->dirent = dirent;
+    vfs_file->dir_pos = NULL;
     vfs_file->offset = 0;
     vfs_file->flags = flags;
+    vfs_file->refcount = 1;
 
     return vfs_file;
     // current_process->fd_table[current_process->num_fds] = vfs_file;
@@ -139,13 +143,10 @@ static vfs_file_t* fat32_vfs_open(vfs_dentry_t* dirent, int flags) {
     // return current_process->num_fds++;
 }
 
-static int fat32_vfs_close(int fd) {
-    (void)fd;
-    // panic("unimplemented!\n");
-
-    // cleanup the file handle, for now just NULL out the fd
-    current_process->fd_table[fd] = NULL;
-
+// from vfs_file_put on the last reference, the fat32_file_t open made goes with it
+static int fat32_vfs_close(vfs_file_t* file) {
+    kfree(file->private_data);
+    file->private_data = NULL;
     return 0;
 }
 
@@ -432,4 +433,7 @@ void init_mount_fat32(void) {
     vfs_inode_t* node = vfs_fat32_mount(mount, NULL);
 
     LOG(INFO, "Mounting FAT32 filesystem at /mnt (WIP)\n");
+
+    // the swap file lives on the card too, anonymous pages go there once memory runs low
+    if (node) swap_init(mount->fs_data);
 }
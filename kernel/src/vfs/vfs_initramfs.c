@@ -0,0 +1,176 @@
+// read-only RAM filesystem, unpacked from the cpio (newc) archive the bootloader loaded
+// file contents are never copied, inodes point straight into the archive
+#include <kernel/vfs.h>
+#include <kernel/boot.h>
+#include <kernel/mm.h>
+#include <kernel/errno.h>
+#include <kernel/heap.h>
+#include <kernel/string.h>
+#include <kernel/panic.h>
+
+#define CPIO_NEWC_MAGIC "070701"
+#define CPIO_TRAILER    "TRAILER!!!"
+#define CPIO_ALIGN(x)   (((x) + 3) & ~3)
+
+#define CPIO_MODE_TYPE  0170000
+#define CPIO_MODE_DIR   0040000
+#define CPIO_MODE_REG   0100000
+#define CPIO_MODE_PERM  0777
+
+struct cpio_newc_header {
+    char c_magic[6];
+    char c_ino[8];
+    char c_mode[8];
+    char c_uid[8];
+    char c_gid[8];
+    char c_nlink[8];
+    char c_mtime[8];
+    char c_filesize[8];
+    char c_devmajor[8];
+    char c_devminor[8];
+    char c_rdevmajor[8];
+    char c_rdevminor[8];
+    char c_namesize[8];
+    char c_check[8];
+};
+
+static uint32_t cpio_hex(const char* field) {
+    uint32_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        char c = field[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= c - '0';
+        else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+        else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+    }
+    return value;
+}
+
+static ssize_t initramfs_read(vfs_file_t* file, void* buffer, size_t count) {
+    vfs_inode_t* inode = file->dirent->inode;
+    if (file->offset >= (off_t)inode->size) return 0;
+
+    size_t remaining = inode->size - file->offset;
+    if (count > remaining) count = remaining;
+
+    memcpy(buffer, (uint8_t*)inode->private_data + file->offset, count);
+    return count;
+}
+
+static ssize_t initramfs_write(vfs_file_t* file, const void* buffer, size_t count) {
+    (void)file, (void)buffer, (void)count;
+    return -EROFS;
+}
+
+static vfs_ops_t initramfs_file_ops = {
+    .open = vfs_default_open,
+    .close = vfs_default_close,
+    .read = initramfs_read,
+    .write = initramfs_write,
+    .readdir = NULL,
+    .lookup = NULL,
+};
+
+// walk (and create) the directories leading up to path, then add the final component
+static vfs_dentry_t* initramfs_add(const char* path, uint32_t mode) {
+    vfs_dentry_t* dir = vfs_root_node;
+    char name[VFS_MAX_FILELEN];
+
+    while (*path) {
+        const char* end = path;
+        while (*end && *end != '/') end++;
+
+        size_t len = end - path;
+        if (len >= VFS_MAX_FILELEN) return ERR_PTR(-EINVAL);
+        memcpy(name, path, len);
+        name[len] = '\0';
+
+        while (*end == '/') end++;
+        int last = *end == '\0';
+
+        vfs_dentry_t* child = vfs_find_child(dir, name);
+        if (!child) {
+            child = vfs_create_dirent(name, last ? mode : (VFS_DIR | 0755));
+            if (!child) return ERR_PTR(-ENOMEM);
+
+            child->inode->ops = &vfs_ops;
+            vfs_add_child(dir, child);
+        } else if (last && !S_ISDIR(child->inode)) {
+            return ERR_PTR(-EEXIST);
+        }
+
+        if (last) return child;
+        if (!S_ISDIR(child->inode)) return ERR_PTR(-ENOTDIR);
+
+        dir = child;
+        path = end;
+    }
+
+    return dir;
+}
+
+int initramfs_init(void) {
+    if (!bootloader_info.initramfs_size) {
+        LOG(WARN, "No initramfs was loaded by the bootloader\n");
+        return -ENOENT;
+    }
+
+    uint8_t* base = (uint8_t*)PHYS_TO_KERNEL_VIRT(bootloader_info.initramfs_base);
+    uint32_t size = bootloader_info.initramfs_size;
+    uint32_t offset = 0;
+    int files = 0;
+
+    while (offset + sizeof(struct cpio_newc_header) <= size) {
+        struct cpio_newc_header* hdr = (struct cpio_newc_header*)(base + offset);
+        if (memcmp(hdr->c_magic, CPIO_NEWC_MAGIC, 6) != 0) {
+            LOG(ERROR, "Bad initramfs header magic at offset %u\n", offset);
+            return -EINVAL;
+        }
+
+        uint32_t mode = cpio_hex(hdr->c_mode);
+        uint32_t filesize = cpio_hex(hdr->c_filesize);
+        uint32_t namesize = cpio_hex(hdr->c_namesize);
+        const char* name = (const char*)(hdr + 1);
+        uint32_t data_offset = CPIO_ALIGN(offset + sizeof(*hdr) + namesize);
+
+        if (data_offset + filesize > size) {
+            LOG(ERROR, "Truncated initramfs entry at offset %u\n", offset);
+            return -EINVAL;
+        }
+
+        if (strcmp(name, CPIO_TRAILER) == 0) break;
+
+        // archive paths are relative, allow "./" and "/" prefixes anyway
+        while (*name == '.' && name[1] == '/') name += 2;
+        while (*name == '/') name++;
+
+        if (*name && strcmp(name, ".") != 0) {
+            vfs_dentry_t* dentry = NULL;
+            uint32_t type = mode & CPIO_MODE_TYPE;
+
+            if (type == CPIO_MODE_DIR) {
+                dentry = initramfs_add(name, VFS_DIR | (mode & CPIO_MODE_PERM));
+            } else if (type == CPIO_MODE_REG) {
+                dentry = initramfs_add(name, VFS_REG | (mode & CPIO_MODE_PERM));
+                if (!IS_ERR(dentry)) {
+                    dentry->inode->ops = &initramfs_file_ops;
+                    dentry->inode->flags |= VFS_INODE_RAM;
+                    dentry->inode->private_data = base + data_offset;
+                    dentry->inode->size = filesize;
+                    files++;
+                }
+            } else {
+                LOG(WARN, "Skipping unsupported initramfs entry %s (mode 0x%x)\n", name, mode);
+            }
+
+            if (IS_ERR(dentry)) {
+                LOG(ERROR, "Failed to add initramfs entry %s (%d)\n", name, PTR_ERR(dentry));
+            }
+        }
+
+        offset = CPIO_ALIGN(data_offset + filesize);
+    }
+
+    LOG(INFO, "Unpacked initramfs: %d files (%dKB) from %p\n", files, size / 1024, bootloader_info.initramfs_base);
+    return 0;
+}
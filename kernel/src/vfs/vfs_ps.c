@@ -0,0 +1,48 @@
+#include <kernel/vfs.h>
+#include <kernel/sched.h>
+#include <kernel/errno.h>
+#include <kernel/string.h>
+#include <kernel/panic.h>
+
+#define PS_BUFFER_SIZE 4096
+
+// too big for a kernel stack, syscalls don't preempt each other so one copy is enough
+static char ps_table[PS_BUFFER_SIZE];
+
+// rendered fresh on every read, like /dev/boottime
+static ssize_t ps_read(vfs_file_t* file, void* buffer, size_t count) {
+    int len = sched_format_processes(ps_table, sizeof(ps_table));
+
+    if (file->offset >= len) return 0;
+    if (count > (size_t)(len - file->offset)) count = len - file->offset;
+
+    memcpy(buffer, ps_table + file->offset, count);
+    return count;
+}
+
+static ssize_t ps_write(vfs_file_t* file, const void* buffer, size_t count) {
+    (void)file, (void)buffer, (void)count;
+    return -EROFS;
+}
+
+static vfs_ops_t ps_ops = {
+    .read = ps_read,
+    .write = ps_write,
+    .open = vfs_default_open,
+    .close = vfs_default_close,
+    .readdir = NULL,
+    .lookup = NULL,
+};
+
+int ps_device_init(void) {
+    vfs_dentry_t* dentry = vfs_create_dirent("ps", VFS_CHR | S_IRUSR);
+    if (!dentry) return -ENOMEM;
+    dentry->inode->ops = &ps_ops;
+
+    vfs_dentry_t* dev_directory = vfs_finddir("/dev");
+    if (!dev_directory) panic("Failed to find /dev directory when loading critical device!");
+    vfs_add_child(dev_directory, dentry);
+
+    LOG(INFO, "Mounted virtual char device 'ps' at /dev/ps\n");
+    return 0;
+}
@@ -0,0 +1,205 @@
+#include <kernel/vfs.h>
+#include <kernel/tty.h>
+#include <kernel/uart.h>
+#include <kernel/ring.h>
+#include <kernel/blocking.h>
+#include <kernel/errno.h>
+#include <kernel/string.h>
+#include <kernel/panic.h>
+#include <kernel/int.h>
+
+// Input is run through the line discipline from the uart rx tasklet, so a reader in canonical
+// mode only gets woken once per finished line instead of once per keystroke.
+// Once the tty is hooked in it owns the uart rx side, /dev/uart0 reads won't see input.
+
+struct tty {
+    uint32_t mode;
+
+    char line[TTY_LINE_MAX];  // line being edited, not visible to read() yet
+    uint32_t line_len;
+
+    uint8_t input_buffer[TTY_INPUT_SIZE];
+    struct ring input;        // rx tasklet is the producer, tty_read the consumer
+    uint32_t lines;           // newlines sitting in input, kept in raw mode too so switching back is right
+    uint32_t dropped;         // lines/bytes lost because input was full
+
+    wait_queue_t read_wait;
+};
+
+static struct tty tty = {
+    .mode = TTY_MODE_DEFAULT,
+    .input = RING_INIT(tty.input_buffer),
+    .read_wait = WAIT_QUEUE_INIT(tty.read_wait),
+};
+__extension__ _Static_assert(RING_IS_POW2(TTY_INPUT_SIZE), "TTY_INPUT_SIZE must be a power of 2");
+
+static void tty_echo(const char* s, uint32_t len) {
+    if (!(tty.mode & TTY_MODE_ECHO)) return;
+    for (uint32_t i = 0; i < len; i++) uart_driver.putc(s[i]);
+}
+
+// hand the edited line to readers, all or nothing so a reader never sees half a line
+static int tty_commit_line(void) {
+    uint32_t len = tty.line_len;
+    tty.line_len = 0;
+
+    if (ring_capacity(&tty.input) - ring_count(&tty.input) < len) {
+        tty.dropped++;
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < len; i++) ring_push(&tty.input, &tty.line[i]);
+    tty.lines++;
+    return 1;
+}
+
+// returns 1 if a reader should be woken
+static int tty_input_char(char c) {
+    if (!(tty.mode & TTY_MODE_CANON)) {
+        if (ring_push(&tty.input, &c)) {
+            tty.dropped++;
+            return 0;
+        }
+        if (c == '\n') tty.lines++;
+        tty_echo(&c, 1);
+        return 1;
+    }
+
+    if (c == '\r') c = '\n'; // terminals send CR for enter
+
+    switch (c) {
+        case TTY_CHAR_ERASE:
+        case '\b':
+            if (tty.line_len) {
+                tty.line_len--;
+                tty_echo("\b \b", 3);
+            }
+            return 0;
+        case TTY_CHAR_KILL:
+            while (tty.line_len) {
+                tty.line_len--;
+                tty_echo("\b \b", 3);
+            }
+            return 0;
+        case '\n':
+            tty.line[tty.line_len++] = '\n'; // always room, see below
+            tty_echo(&c, 1);
+            return tty_commit_line();
+        default:
+            // leave the last slot for the newline
+            if (tty.line_len >= TTY_LINE_MAX - 1) return 0;
+            tty.line[tty.line_len++] = c;
+            tty_echo(&c, 1);
+            return 0;
+    }
+}
+
+// uart rx callback, runs from the rx tasklet with IRQs on
+static void tty_receive(void) {
+    char buf[32];
+    int n, wake = 0;
+
+    while ((n = uart_driver.read(buf, sizeof(buf))) > 0) {
+        for (int i = 0; i < n; i++) wake |= tty_input_char(buf[i]);
+    }
+
+    if (wake) wake_up_all(&tty.read_wait);
+}
+
+static int tty_input_ready(void) {
+    return (tty.mode & TTY_MODE_CANON) ? tty.lines > 0 : !ring_empty(&tty.input);
+}
+
+// copy out up to count bytes, in canonical mode stop after the first newline
+static ssize_t tty_copy_out(char* dest, size_t count) {
+    size_t copied = 0;
+    char c;
+
+    while (copied < count && !ring_pop(&tty.input, &c)) {
+        dest[copied++] = c;
+        if (c == '\n') {
+            tty.lines--;
+            if (tty.mode & TTY_MODE_CANON) break;
+        }
+    }
+
+    return copied;
+}
+
+static ssize_t tty_read(vfs_file_t* file, void* buffer, size_t count) {
+    if (!(file->flags & OPEN_MODE_READ)) return -EBADF;
+    if (!uart_driver.read) return -ENOTSUP;
+
+    // keep the irq out while checking, or a wakeup could land before we're on the queue
+    uint32_t flags = local_irq_save();
+    ssize_t ret;
+
+    while (!tty_input_ready()) {
+        if (file->flags & OPEN_MODE_NOBLOCK) {
+            local_irq_restore(flags);
+            return -EAGAIN;
+        }
+        block_on(&tty.read_wait);
+    }
+    ret = tty_copy_out((char*)buffer, count);
+
+    local_irq_restore(flags);
+    return ret;
+}
+
+static ssize_t tty_write(vfs_file_t* file, const void* buffer, size_t count) {
+    return uart0_write(file, buffer, count);
+}
+
+static int tty_set_mode(uint32_t mode) {
+    if (mode & ~(TTY_MODE_CANON | TTY_MODE_ECHO)) return -EINVAL;
+
+    uint32_t flags = local_irq_save();
+    // going raw, whatever was typed so far becomes readable as is. It has no newline
+    // (that would have committed it) so lines stays as it is
+    if ((tty.mode & TTY_MODE_CANON) && !(mode & TTY_MODE_CANON)) {
+        uint32_t len = tty.line_len;
+        for (uint32_t i = 0; i < len; i++) ring_push(&tty.input, &tty.line[i]);
+        tty.line_len = 0;
+        if (len) wake_up_all(&tty.read_wait);
+    }
+    tty.mode = mode;
+    local_irq_restore(flags);
+
+    return 0;
+}
+
+static int tty_ioctl(vfs_file_t* file, uint32_t cmd, uint32_t arg) {
+    (void)file;
+
+    switch (cmd) {
+        case TTY_IOCTL_GET_MODE: return tty.mode;
+        case TTY_IOCTL_SET_MODE: return tty_set_mode(arg);
+        default: return -ENOTTY;
+    }
+}
+
+static vfs_ops_t tty_ops = {
+    .read = tty_read,
+    .write = tty_write,
+    .open = vfs_default_open,
+    .close = vfs_default_close,
+    .readdir = NULL,
+    .lookup = NULL,
+    .ioctl = tty_ioctl,
+};
+
+int tty_device_init(void) {
+    vfs_dentry_t* dentry = vfs_create_dirent("tty", VFS_CHR | S_IRUSR | S_IWUSR);
+    if (!dentry) return -ENOMEM;
+    dentry->inode->ops = &tty_ops;
+
+    vfs_dentry_t* dev_directory = vfs_finddir("/dev");
+    if (!dev_directory) panic("Failed to find /dev directory when loading critical device!");
+    vfs_add_child(dev_directory, dentry);
+
+    uart_driver.rx_callback = tty_receive;
+
+    LOG(INFO, "Mounted virtual char device 'tty' at /dev/tty\n");
+    return 0;
+}
@@ -0,0 +1,474 @@
+#include <kernel/vma.h>
+#include <kernel/slab.h>
+#include <kernel/paging.h>
+#include <kernel/mmu.h>
+#include <kernel/mm.h>
+#include <kernel/errno.h>
+#include <kernel/string.h>
+#include <kernel/swap.h>
+#include <kernel/int.h>
+
+static struct kmem_cache vma_cache = KMEM_CACHE_INIT(vma_cache, "vm_area", struct vm_area);
+
+#define L2_SPAN (1 << 20) // address space behind one L2 table
+
+// untouched anonymous pages are all mapped to this one page of zeroes, read only for
+// everyone (AP[2] set), so the first write faults and gets a page of its own. It's allocated
+// on first use and never freed, mappings of it don't hold a reference
+static uint32_t zero_page;
+
+#define ZERO_PAGE_PROT(vma) ((vma)->prot | PAGE_AP2_ENABLED)
+
+// Anonymous pages can be pushed out to swap. Which ones is down to a clock over the page
+// descriptors: the hand takes the mapping of a page it passes away but leaves the page (an
+// idle pte). Touching it again faults and just maps it back, the hardware has no referenced
+// bit we can use so that fault is the referenced bit. A page that's still idle when the hand
+// comes round again goes to swap and its pte remembers the slot.
+//
+// Idle and swapped ptes have bits [1:0] clear, so the MMU treats them as faults
+#define PTE_IDLE        0x4
+#define PTE_SWAP        0x8
+#define PTE_SLOT_SHIFT  12
+
+#define RECLAIM_LOW     64  // free pages kept back for the kernel, user allocations reclaim below this
+#define RECLAIM_BATCH   16
+
+static uint32_t clock_hand;     // index into kpage_allocator.pages
+static int tlb_stale;           // ptes went idle since the last TLB flush
+
+static inline int pte_idle(uint32_t pte) {
+    return !(pte & L2_SMALL_PAGE) && (pte & PTE_IDLE);
+}
+
+static inline int pte_swapped(uint32_t pte) {
+    return !(pte & L2_SMALL_PAGE) && (pte & PTE_SWAP);
+}
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+void mm_init(struct mm* mm) {
+    INIT_LIST_HEAD(&mm->vmas);
+    mm->tree = NULL;
+    mm->cache = NULL;
+    mm->num_vmas = 0;
+    mm->rss = 0;
+    mm->start_brk = 0;
+    mm->brk = 0;
+    mm->stack_limit = USER_STACK_LIMIT;
+}
+
+struct vm_area* find_vma(struct mm* mm, uint32_t addr) {
+    struct vm_area* vma = mm->cache;
+    if (vma && addr >= vma->start && addr < vma->end) return vma;
+
+    vma = vma_tree_find(mm, addr);
+    if (vma) mm->cache = vma;
+    return vma;
+}
+
+struct vm_area* vma_create(struct mm* mm, uint32_t start, uint32_t end, uint32_t prot, enum vma_type type, uint32_t flags) {
+    if (start >= end || end > KERNEL_DIVIDER || ((start | end) & (PAGE_SIZE - 1))) return ERR_PTR(-EINVAL);
+
+    struct vm_area* next = vma_tree_above(mm, start);
+    if (next && next->start < end) return ERR_PTR(-EEXIST);
+
+    struct vm_area* vma = kmem_cache_alloc(&vma_cache);
+    if (!vma) return ERR_PTR(-ENOMEM);
+
+    vma->start = start;
+    vma->end = end;
+    vma->prot = prot;
+    vma->type = type;
+    vma->flags = flags;
+    vma->backing = 0;
+    vma_tree_link(mm, vma);
+    mm->num_vmas++;
+    return vma;
+}
+
+uint32_t vma_reclaim(uint32_t count) {
+    struct page_allocator* alloc = &kpage_allocator;
+    uint32_t freed = 0;
+
+    if (count > swap_free_slots()) count = swap_free_slots();
+    if (!count) return 0; // no swap, taking mappings away would only cost faults
+
+    uint32_t flags = local_irq_save();
+
+    // two turns at most, the first one may only find pages that were used since last time
+    for (uint32_t n = 0; n < 2 * alloc->total_pages && freed < count; n++) {
+        struct page* page = &alloc->pages[clock_hand];
+        clock_hand = (clock_hand + 1) % alloc->total_pages;
+        if (!(page->flags & PAGE_ANON)) continue;
+
+        uint32_t pte = *page->pte;
+        if (pte & L2_SMALL_PAGE) {
+            *page->pte = (pte & ~0xFFF) | PTE_IDLE; // second chance
+            tlb_stale = 1;
+            continue;
+        }
+
+        // a stale TLB entry would let writes go on after the page has been written out
+        if (tlb_stale) {
+            mmu_driver.flush_tlb();
+            tlb_stale = 0;
+        }
+
+        int slot = swap_out(PHYS_TO_KERNEL_VIRT(page->paddr));
+        if (slot < 0) break;
+
+        *page->pte = ((uint32_t)slot << PTE_SLOT_SHIFT) | PTE_SWAP;
+        page->mm->rss--;
+        page->flags &= ~PAGE_ANON;
+        page_put(alloc, page->paddr);
+        freed++;
+    }
+
+    local_irq_restore(flags);
+    return freed;
+}
+
+// user pages come after everything the kernel needs, so start pushing anonymous pages out
+// before the allocator runs dry rather than when it does
+static void* vma_get_page(void) {
+    if (kpage_allocator.free_pages < RECLAIM_LOW) vma_reclaim(RECLAIM_BATCH);
+    return alloc_page(&kpage_allocator);
+}
+
+// writable pages are private, those are the ones the clock gets to look at
+static void vma_track(struct mm* mm, struct vm_area* vma, uint32_t* pte, void* paddr) {
+    if ((vma->flags & (VMA_WRITE | VMA_PINNED)) != VMA_WRITE) return;
+
+    struct page* page = page_desc(&kpage_allocator, paddr);
+    page->flags |= PAGE_ANON;
+    page->pte = pte;
+    page->mm = mm;
+}
+
+void* vma_alloc_page(struct mm* mm, uint32_t* ttbr0, struct vm_area* vma, uint32_t vaddr) {
+    void* paddr = vma_get_page();
+    if (!paddr) return NULL;
+
+    void* page = PHYS_TO_KERNEL_VIRT(paddr);
+    clear_page(page);
+    mmu_driver.map_page(ttbr0, (void*)vaddr, paddr, vma->prot);
+    vma_track(mm, vma, mmu_driver.get_pte(ttbr0, (void*)vaddr), paddr);
+    mm->rss++;
+    return page;
+}
+
+static inline int is_zero_page(uint32_t pte) {
+    return zero_page && (pte & ~0xFFF) == zero_page;
+}
+
+static int vma_map_zero(struct mm* mm, uint32_t* ttbr0, struct vm_area* vma, uint32_t vaddr) {
+    if (!zero_page) {
+        void* paddr = vma_get_page();
+        if (!paddr) return -ENOMEM;
+        clear_page(PHYS_TO_KERNEL_VIRT(paddr));
+        zero_page = (uint32_t)paddr;
+    }
+
+    mmu_driver.map_page(ttbr0, (void*)vaddr, (void*)zero_page, ZERO_PAGE_PROT(vma));
+    mm->rss++;
+    return 0;
+}
+
+// faults are always taken in the running address space, so its ASID is the one in CONTEXTIDR
+static void flush_tlb_page(uint32_t vaddr) {
+    uint32_t asid;
+    __asm__ volatile("mrc p15, 0, %0, c13, c0, 1" : "=r"(asid));
+    __asm__ volatile("dsb" ::: "memory");
+    invalidate_tlb_single(vaddr | (asid & 0xFF));
+    __asm__ volatile("dsb\n isb" ::: "memory");
+}
+
+// first write to a page that's still on the zero page, swap in a private one. No copy needed,
+// a fresh page is zeroed anyway
+static int vma_unshare_zero(struct mm* mm, struct vm_area* vma, uint32_t* pte, uint32_t vaddr) {
+    void* paddr = vma_get_page();
+    if (!paddr) return -ENOMEM;
+
+    clear_page(PHYS_TO_KERNEL_VIRT(paddr));
+    *pte = (uint32_t)paddr | L2_SMALL_PAGE | vma->prot;
+    vma_track(mm, vma, pte, paddr);
+    flush_tlb_page(vaddr);
+    return 0;
+}
+
+static int vma_swap_in(struct mm* mm, struct vm_area* vma, uint32_t* pte) {
+    void* paddr = vma_get_page();
+    if (!paddr) return -ENOMEM;
+
+    uint32_t slot = *pte >> PTE_SLOT_SHIFT;
+    if (swap_in(slot, PHYS_TO_KERNEL_VIRT(paddr)) != 0) {
+        free_page(&kpage_allocator, paddr);
+        return -EIO;
+    }
+
+    swap_free(slot);
+    *pte = (uint32_t)paddr | L2_SMALL_PAGE | vma->prot;
+    vma_track(mm, vma, pte, paddr);
+    mm->rss++;
+    return 0;
+}
+
+static void vma_map_backing(struct mm* mm, uint32_t* ttbr0, struct vm_area* vma, uint32_t vaddr) {
+    mmu_driver.map_page(ttbr0, (void*)vaddr, (void*)(vma->backing + (vaddr - vma->start)), vma->prot);
+    mm->rss++;
+}
+
+int vma_populate(struct mm* mm, uint32_t* ttbr0, struct vm_area* vma) {
+    for (uint32_t vaddr = vma->start; vaddr < vma->end; vaddr += PAGE_SIZE) {
+        if (vma->flags & VMA_PINNED) {
+            vma_map_backing(mm, ttbr0, vma, vaddr);
+        } else if (!vma_alloc_page(mm, ttbr0, vma, vaddr)) {
+            return -ENOMEM;
+        }
+    }
+    return 0;
+}
+
+// pte of the first page in [*vaddr, end) that's mapped, idle or swapped, which is left in
+// *vaddr, or NULL if there's none. Sections without an L2 table are skipped whole, so big
+// sparse areas are cheap to walk
+static uint32_t* vma_next_mapped(uint32_t* ttbr0, uint32_t* vaddr, uint32_t end) {
+    while (*vaddr < end) {
+        uint32_t* pte = mmu_driver.get_pte(ttbr0, (void*)*vaddr);
+        if (!pte) {
+            *vaddr = (*vaddr & ~(L2_SPAN - 1)) + L2_SPAN;
+            continue;
+        }
+        if (*pte) return pte;
+        *vaddr += PAGE_SIZE;
+    }
+    return NULL;
+}
+
+// unmap whatever is mapped in [start, end) of vma
+static void vma_drop_pages(struct mm* mm, uint32_t* ttbr0, struct vm_area* vma, uint32_t start, uint32_t end) {
+    uint32_t* pte;
+    for (uint32_t vaddr = start; (pte = vma_next_mapped(ttbr0, &vaddr, end)); vaddr += PAGE_SIZE) {
+        if (pte_swapped(*pte)) {
+            swap_free(*pte >> PTE_SLOT_SHIFT);
+        } else {
+            if (!(vma->flags & VMA_PINNED) && !is_zero_page(*pte)) {
+                void* paddr = (void*)(*pte & ~0xFFF);
+                page_desc(&kpage_allocator, paddr)->flags &= ~PAGE_ANON;
+                page_put(&kpage_allocator, paddr);
+            }
+            mm->rss--;
+        }
+        *pte = 0;
+    }
+}
+
+static void vma_free(struct mm* mm, struct vm_area* vma) {
+    if (mm->cache == vma) mm->cache = NULL;
+    vma_tree_unlink(mm, vma);
+    kmem_cache_free(&vma_cache, vma);
+    mm->num_vmas--;
+}
+
+// nothing mapped anywhere in [start, end)
+static int vma_range_free(struct mm* mm, uint32_t start, uint32_t end) {
+    struct vm_area* vma = vma_tree_above(mm, start);
+    return !vma || vma->start >= end;
+}
+
+// addr isn't in any area, but it may be just below a stack. Grow the stack down over it if
+// that stays inside the stack limit and leaves a free guard page above whatever is below.
+// The lowest page of the reservation is always a guard
+static struct vm_area* vma_grow_stack(struct mm* mm, uint32_t addr) {
+    struct vm_area* vma = vma_tree_above(mm, addr); // addr is in no area, so this one starts above it
+    if (!vma || !(vma->flags & VMA_GROWSDOWN)) return ERR_PTR(-EFAULT);
+    struct vm_area* below = (vma->list.prev == &mm->vmas) ? NULL : list_entry(vma->list.prev, struct vm_area, list);
+
+    uint32_t start = addr & ~(PAGE_SIZE - 1);
+    uint32_t reserve = (vma->end > mm->stack_limit) ? vma->end - mm->stack_limit : 0;
+    if (start < reserve) return ERR_PTR(-EFAULT);
+    if (start < reserve + PAGE_SIZE || (below && below->end + PAGE_SIZE > start)) return ERR_PTR(-EOVERFLOW);
+
+    vma->start = start;
+    vma_tree_resized(mm, vma);
+    mm->cache = vma;
+    return vma;
+}
+
+int vma_range_ok(struct mm* mm, uint32_t addr, uint32_t len) {
+    uint32_t end = addr + len;
+    if (end < addr || end > KERNEL_DIVIDER) return 0;
+
+    while (addr < end) {
+        struct vm_area* vma = find_vma(mm, addr);
+        if (!vma) vma = vma_grow_stack(mm, addr); // a buffer on stack that hasn't been touched yet
+        if (IS_ERR(vma)) return 0;
+        addr = vma->end;
+    }
+    return 1;
+}
+
+int vma_fault(struct mm* mm, uint32_t* ttbr0, uint32_t addr, int write) {
+    struct vm_area* vma = find_vma(mm, addr);
+    if (!vma) vma = vma_grow_stack(mm, addr);
+    if (IS_ERR(vma)) return PTR_ERR(vma);
+    if (write && !(vma->flags & VMA_WRITE)) return -EACCES;
+
+    uint32_t vaddr = addr & ~(PAGE_SIZE - 1);
+    uint32_t* pte = mmu_driver.get_pte(ttbr0, (void*)vaddr);
+    if (pte && (*pte & L2_SMALL_PAGE)) {
+        if (write && is_zero_page(*pte)) return vma_unshare_zero(mm, vma, pte, vaddr);
+        return 0; // someone got here first, just retry
+    }
+    if (pte && pte_idle(*pte)) {
+        *pte = (*pte & ~0xFFF) | L2_SMALL_PAGE | vma->prot; // still in use, the clock passes it by next time
+        return 0;
+    }
+    if (pte && pte_swapped(*pte)) return vma_swap_in(mm, vma, pte);
+
+    if (vma->flags & VMA_PINNED) {
+        vma_map_backing(mm, ttbr0, vma, vaddr);
+        return 0;
+    }
+
+    // reads of memory nobody wrote yet don't need a page of their own
+    if (!write) return vma_map_zero(mm, ttbr0, vma, vaddr);
+    return vma_alloc_page(mm, ttbr0, vma, vaddr) ? 0 : -ENOMEM;
+}
+
+int vma_unmap(struct mm* mm, uint32_t* ttbr0, uint32_t start, uint32_t end) {
+    if (start >= end || end > KERNEL_DIVIDER || ((start | end) & (PAGE_SIZE - 1))) return -EINVAL;
+
+    // the first area the range reaches, then along the list from there
+    struct vm_area* vma = vma_tree_above(mm, start), *next;
+    for (; vma && vma->start < end; vma = next) {
+        next = (vma->list.next == &mm->vmas) ? NULL : list_entry(vma->list.next, struct vm_area, list);
+
+        uint32_t from = MAX(vma->start, start);
+        uint32_t to = MIN(vma->end, end);
+
+        if (from > vma->start && to < vma->end) {
+            // hole in the middle, the part above it becomes an area of its own
+            struct vm_area* upper = kmem_cache_alloc(&vma_cache);
+            if (!upper) return -ENOMEM;
+
+            *upper = *vma;
+            upper->start = to;
+            upper->backing += to - vma->start;
+
+            vma_drop_pages(mm, ttbr0, vma, from, to);
+            vma->end = from;
+            vma_tree_resized(mm, vma);
+            vma_tree_link(mm, upper);
+            mm->num_vmas++;
+            break;
+        }
+
+        vma_drop_pages(mm, ttbr0, vma, from, to);
+        if (from == vma->start && to == vma->end) {
+            vma_free(mm, vma);
+        } else if (from == vma->start) {
+            vma->backing += to - vma->start;
+            vma->start = to;
+            vma_tree_resized(mm, vma);
+        } else {
+            vma->end = from;
+            vma_tree_resized(mm, vma);
+        }
+    }
+    return 0;
+}
+
+int mm_brk(struct mm* mm, uint32_t* ttbr0, uint32_t brk) {
+    if (brk < mm->start_brk || brk > KERNEL_DIVIDER) return -EINVAL;
+
+    uint32_t old_end = PAGE_ALIGN(mm->brk);
+    uint32_t new_end = PAGE_ALIGN(brk);
+
+    if (new_end > old_end) {
+        if (!vma_range_free(mm, old_end, new_end)) return -ENOMEM; // would run into an mmap
+        struct vm_area* heap = (old_end > mm->start_brk) ? find_vma(mm, old_end - 1) : NULL;
+        if (heap && heap->type == VMA_HEAP) {
+            heap->end = new_end;
+            vma_tree_resized(mm, heap);
+        } else {
+            heap = vma_create(mm, old_end, new_end, L2_USER_DATA_PAGE, VMA_HEAP, VMA_WRITE);
+            if (IS_ERR(heap)) return PTR_ERR(heap);
+        }
+    } else if (new_end < old_end) {
+        int err = vma_unmap(mm, ttbr0, new_end, old_end);
+        if (err) return err;
+    }
+
+    mm->brk = brk;
+    return 0;
+}
+
+struct vm_area* mm_mmap(struct mm* mm, uint32_t* ttbr0, uint32_t addr, uint32_t len, uint32_t prot, uint32_t flags) {
+    if (flags & MAP_SHARED || !(flags & MAP_ANONYMOUS)) return ERR_PTR(-ENOTSUP);
+    if (!len || len > KERNEL_DIVIDER) return ERR_PTR(-EINVAL);
+    len = PAGE_ALIGN(len);
+
+    if (flags & MAP_FIXED) {
+        if (addr & (PAGE_SIZE - 1) || addr < PAGE_SIZE || addr + len > KERNEL_DIVIDER) return ERR_PTR(-EINVAL);
+        int err = vma_unmap(mm, ttbr0, addr, addr + len);
+        if (err) return ERR_PTR(err);
+    } else {
+        // stay clear of the stack reservation
+        addr = vma_tree_gap(mm, len, MEMORY_USER_MMAP_BASE, MEMORY_USER_STACK_BASE + PAGE_SIZE - mm->stack_limit);
+        if (!addr) return ERR_PTR(-ENOMEM);
+    }
+
+    // the L2 XN bit isn't in the flag set yet, anything readable can be executed
+    uint32_t bits = (prot & PROT_WRITE) ? L2_USER_DATA_PAGE : L2_USER_CODE_PAGE;
+    return vma_create(mm, addr, addr + len, bits, VMA_MMAP, (prot & PROT_WRITE) ? VMA_WRITE : 0);
+}
+
+int mm_clone(struct mm* dst, uint32_t* dst_ttbr0, struct mm* src, uint32_t* src_ttbr0) {
+    struct vm_area* vma;
+    uint32_t* pte;
+
+    dst->start_brk = src->start_brk;
+    dst->brk = src->brk;
+    dst->stack_limit = src->stack_limit;
+
+    list_for_each_entry(vma, struct vm_area, &src->vmas, list) {
+        struct vm_area* copy = vma_create(dst, vma->start, vma->end, vma->prot, vma->type, vma->flags);
+        if (IS_ERR(copy)) return PTR_ERR(copy);
+        copy->backing = vma->backing;
+
+        // pages that were never touched stay that way in the child too
+        for (uint32_t vaddr = vma->start; (pte = vma_next_mapped(src_ttbr0, &vaddr, vma->end)); vaddr += PAGE_SIZE) {
+            uint32_t paddr = *pte & ~0xFFF;
+
+            if ((vma->flags & (VMA_WRITE | VMA_PINNED)) == VMA_WRITE && !is_zero_page(*pte)) {
+                // allocating can push the parent's page out, so look at its pte only afterwards
+                void* page = vma_alloc_page(dst, dst_ttbr0, copy, vaddr);
+                if (!page) return -ENOMEM;
+
+                if (pte_swapped(*pte)) {
+                    if (swap_in(*pte >> PTE_SLOT_SHIFT, page) != 0) return -EIO;
+                } else {
+                    copy_page(page, PHYS_TO_KERNEL_VIRT(*pte & ~0xFFF));
+                }
+            } else {
+                // same flags as in the parent, so zero page mappings stay read only
+                if (!(vma->flags & VMA_PINNED) && !is_zero_page(*pte)) page_get(&kpage_allocator, (void*)paddr);
+                mmu_driver.map_page(dst_ttbr0, (void*)vaddr, (void*)paddr, *pte & 0xFFF);
+                dst->rss++;
+            }
+        }
+    }
+    return 0;
+}
+
+void mm_release(struct mm* mm, uint32_t* ttbr0) {
+    struct vm_area* vma, *next;
+    list_for_each_entry_safe(vma, struct vm_area, next, &mm->vmas, list) {
+        vma_drop_pages(mm, ttbr0, vma, vma->start, vma->end);
+        vma_free(mm, vma);
+    }
+
+    mm_init(mm);
+}
@@ -0,0 +1,208 @@
+#include <kernel/vma.h>
+
+// mm->tree is an AVL tree of the areas keyed by start. Areas never overlap, so ends come out
+// sorted the same way and one descent answers "which area holds addr" or "first area past addr".
+//
+// Every node also carries the free gap right below its area (down to the previous area's end,
+// or 0) and the largest such gap in its subtree. That lets vma_tree_gap skip whole subtrees that
+// can't fit a request, so mmap finds its first fit without walking every area. A gap belongs to
+// the area above it, so moving an area's end changes its successor's gap too, see vma_tree_resized.
+//
+// mm->vmas keeps the same areas in order for walks and neighbours, the functions here update both.
+
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+static inline uint32_t height(const struct vm_area* n) {
+    return n ? n->height : 0;
+}
+
+static inline uint32_t max_gap(const struct vm_area* n) {
+    return n ? n->max_gap : 0;
+}
+
+static inline struct vm_area* vma_prev(struct mm* mm, struct vm_area* vma) {
+    return vma->list.prev == &mm->vmas ? NULL : list_entry(vma->list.prev, struct vm_area, list);
+}
+
+static inline struct vm_area* vma_next(struct mm* mm, struct vm_area* vma) {
+    return vma->list.next == &mm->vmas ? NULL : list_entry(vma->list.next, struct vm_area, list);
+}
+
+static void update(struct vm_area* n) {
+    n->height = 1 + MAX(height(n->left), height(n->right));
+    n->max_gap = MAX(n->gap, MAX(max_gap(n->left), max_gap(n->right)));
+}
+
+static void replace_child(struct mm* mm, struct vm_area* parent, struct vm_area* old, struct vm_area* new) {
+    if (!parent) mm->tree = new;
+    else if (parent->left == old) parent->left = new;
+    else parent->right = new;
+    if (new) new->parent = parent;
+}
+
+static struct vm_area* rotate_left(struct mm* mm, struct vm_area* x) {
+    struct vm_area* y = x->right;
+    x->right = y->left;
+    if (y->left) y->left->parent = x;
+    replace_child(mm, x->parent, x, y);
+    y->left = x;
+    x->parent = y;
+    update(x);
+    update(y);
+    return y;
+}
+
+static struct vm_area* rotate_right(struct mm* mm, struct vm_area* x) {
+    struct vm_area* y = x->left;
+    x->left = y->right;
+    if (y->right) y->right->parent = x;
+    replace_child(mm, x->parent, x, y);
+    y->right = x;
+    x->parent = y;
+    update(x);
+    update(y);
+    return y;
+}
+
+// refresh heights and gaps from n up to the root, rotating wherever it's out of balance
+static void rebalance(struct mm* mm, struct vm_area* n) {
+    while (n) {
+        update(n);
+        int balance = (int)height(n->left) - (int)height(n->right);
+        if (balance > 1) {
+            if (height(n->left->left) < height(n->left->right)) rotate_left(mm, n->left);
+            n = rotate_right(mm, n);
+        } else if (balance < -1) {
+            if (height(n->right->right) < height(n->right->left)) rotate_right(mm, n->right);
+            n = rotate_left(mm, n);
+        }
+        n = n->parent;
+    }
+}
+
+// the gap below vma changed, because it or its predecessor moved
+static void refresh_gap(struct mm* mm, struct vm_area* vma) {
+    struct vm_area* prev = vma_prev(mm, vma);
+    vma->gap = vma->start - (prev ? prev->end : 0);
+    rebalance(mm, vma);
+}
+
+struct vm_area* vma_tree_find(struct mm* mm, uint32_t addr) {
+    struct vm_area* n = mm->tree;
+    while (n) {
+        if (addr < n->start) n = n->left;
+        else if (addr < n->end) return n;
+        else n = n->right;
+    }
+    return NULL;
+}
+
+struct vm_area* vma_tree_above(struct mm* mm, uint32_t addr) {
+    struct vm_area* n = mm->tree, *best = NULL;
+    while (n) {
+        if (n->end > addr) {
+            best = n;
+            n = n->left;
+        } else {
+            n = n->right;
+        }
+    }
+    return best;
+}
+
+void vma_tree_link(struct mm* mm, struct vm_area* vma) {
+    struct vm_area* next = vma_tree_above(mm, vma->start);
+    list_add_tail(&vma->list, next ? &next->list : &mm->vmas);
+
+    struct vm_area* parent = NULL, **link = &mm->tree;
+    while (*link) {
+        parent = *link;
+        link = (vma->start < parent->start) ? &parent->left : &parent->right;
+    }
+    *link = vma;
+    vma->parent = parent;
+    vma->left = vma->right = NULL;
+
+    refresh_gap(mm, vma);
+    if (next) refresh_gap(mm, next);
+}
+
+void vma_tree_unlink(struct mm* mm, struct vm_area* vma) {
+    struct vm_area* next = vma_next(mm, vma);
+    struct vm_area* from;
+
+    if (!vma->left || !vma->right) {
+        from = vma->parent;
+        replace_child(mm, vma->parent, vma, vma->left ? vma->left : vma->right);
+    } else {
+        // two children, the in-order successor takes vma's place in the tree
+        struct vm_area* succ = vma->right;
+        while (succ->left) succ = succ->left;
+
+        if (succ->parent != vma) {
+            from = succ->parent;
+            replace_child(mm, succ->parent, succ, succ->right);
+            succ->right = vma->right;
+            succ->right->parent = succ;
+        } else {
+            from = succ;
+        }
+        replace_child(mm, vma->parent, vma, succ);
+        succ->left = vma->left;
+        succ->left->parent = succ;
+    }
+    rebalance(mm, from);
+
+    list_del(&vma->list);
+    if (next) refresh_gap(mm, next);
+}
+
+void vma_tree_resized(struct mm* mm, struct vm_area* vma) {
+    refresh_gap(mm, vma);
+
+    struct vm_area* next = vma_next(mm, vma);
+    if (next) refresh_gap(mm, next);
+}
+
+// leftmost area in n's subtree with at least len free below it, n->max_gap says there is one
+static struct vm_area* leftmost_fit(struct vm_area* n, uint32_t len) {
+    for (;;) {
+        if (max_gap(n->left) >= len) n = n->left;
+        else if (n->gap >= len) return n;
+        else n = n->right;
+    }
+}
+
+// first area after vma, in address order, with at least len free below it
+static struct vm_area* next_fit(struct vm_area* vma, uint32_t len) {
+    if (max_gap(vma->right) >= len) return leftmost_fit(vma->right, len);
+
+    // coming up from a left child, the parent and then its right subtree are next in order
+    for (struct vm_area* n = vma; n->parent; n = n->parent) {
+        struct vm_area* p = n->parent;
+        if (p->left != n) continue;
+        if (p->gap >= len) return p;
+        if (max_gap(p->right) >= len) return leftmost_fit(p->right, len);
+    }
+    return NULL;
+}
+
+uint32_t vma_tree_gap(struct mm* mm, uint32_t len, uint32_t lo, uint32_t hi) {
+    if (!len || lo > hi || hi - lo < len) return 0;
+
+    // the gap lo falls in is the only one that's cut short, so it's checked on its own
+    struct vm_area* vma = vma_tree_above(mm, lo);
+    if (!vma) return lo;
+    if (vma->start >= lo && vma->start - lo >= len) return lo;
+
+    // everything past it lies wholly above lo
+    struct vm_area* fit = next_fit(vma, len);
+    uint32_t addr;
+    if (fit) {
+        addr = fit->start - fit->gap;
+    } else {
+        struct vm_area* last = list_entry(mm->vmas.prev, struct vm_area, list);
+        addr = last->end;
+    }
+    return (addr <= hi && hi - addr >= len) ? addr : 0;
+}
@@ -0,0 +1,47 @@
+#include <kernel/workqueue.h>
+#include <kernel/blocking.h>
+#include <kernel/sched.h>
+#include <kernel/errno.h>
+#include <kernel/panic.h>
+#include <kernel/int.h>
+
+static LIST_HEAD(work_queue);
+static wait_queue_t kworker_wait = WAIT_QUEUE_INIT(kworker_wait);
+
+int schedule_work(struct work* work) {
+    uint32_t flags = local_irq_save();
+    if (work->pending) {
+        local_irq_restore(flags);
+        return 0;
+    }
+
+    work->pending = 1;
+    list_add_tail(&work->list, &work_queue);
+    wake_up_one(&kworker_wait);
+    local_irq_restore(flags);
+    return 1;
+}
+
+static int kworker(void* arg) {
+    (void)arg;
+
+    while (1) {
+        uint32_t flags = local_irq_save();
+        while (list_empty(&work_queue)) block_on(&kworker_wait);
+
+        struct work* work = list_entry(work_queue.next, struct work, list);
+        list_del(&work->list);
+        work->pending = 0; // requeueing itself from fn is fine
+        local_irq_restore(flags);
+
+        work->fn(work);
+        cond_resched();
+    }
+
+    return 0;
+}
+
+void workqueue_init(void) {
+    process_t* p = kthread_create(kworker, NULL, "kworker");
+    if (IS_ERR(p)) panic("Failed to start kworker (%d)\n", PTR_ERR(p));
+}
@@ -0,0 +1,25 @@
+// CHECK and the failure count shared by the host tests. Only the first 20 failures are
+// printed, main returns check_done("name") for the summary and the exit code.
+#ifndef TESTS_CHECK_H
+#define TESTS_CHECK_H
+
+#include <stdio.h>
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        if (failures++ < 20) { printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } \
+    } \
+} while (0)
+
+static inline int check_done(const char* name) {
+    if (failures) {
+        printf("%s: %d failures\n", name, failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+#endif // TESTS_CHECK_H
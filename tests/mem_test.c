@@ -0,0 +1,119 @@
+// memset/memcpy/memmove/memcmp from kernel/src/utils.c against byte at a time references,
+// over every head and tail alignment and lengths either side of the 32 byte burst.
+// memcpy & co. in here are the kernel's, see KERNEL_NAMES in the Makefile
+#include <stdio.h>
+#include <stdint.h>
+#include <kernel/string.h>
+#include "check.h"
+
+#define BUF_SIZE 8192
+#define GUARD    0xEE
+
+static uint8_t dst[BUF_SIZE], src[BUF_SIZE], expect[BUF_SIZE];
+
+static const uint32_t lengths[] = {
+    0, 1, 2, 3, 4, 5, 7, 8, 15, 16, 31, 32, 33, 35, 63, 64, 65, 95, 96, 97, 127, 128, 129,
+    255, 256, 257, 1000, 4095, 4096, 4097,
+};
+#define NUM_LENGTHS (sizeof(lengths) / sizeof(lengths[0]))
+
+static void fill(uint8_t* buf, uint32_t len, uint32_t seed) {
+    for (uint32_t i = 0; i < len; i++) buf[i] = (uint8_t)(seed + i * 7 + (i >> 8));
+}
+
+static void guard(uint8_t* buf) {
+    for (uint32_t i = 0; i < BUF_SIZE; i++) buf[i] = GUARD;
+}
+
+static int same(const uint8_t* a, const uint8_t* b, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) if (a[i] != b[i]) return 0;
+    return 1;
+}
+
+static void test_memset(void) {
+    static const int values[] = {0, 0xFF, 0xA5, 0x100 + 0x12, -1};
+    for (uint32_t v = 0; v < sizeof(values) / sizeof(values[0]); v++) {
+        for (uint32_t off = 0; off < 8; off++) {
+            for (uint32_t l = 0; l < NUM_LENGTHS; l++) {
+                uint32_t len = lengths[l];
+                guard(dst);
+                guard(expect);
+                for (uint32_t i = 0; i < len; i++) expect[16 + off + i] = (uint8_t)values[v];
+
+                void* ret = memset(dst + 16 + off, values[v], len);
+                CHECK(ret == dst + 16 + off, "memset return, off %u len %u", off, len);
+                CHECK(same(dst, expect, BUF_SIZE), "memset value %d off %u len %u", values[v], off, len);
+            }
+        }
+    }
+}
+
+static void test_memcpy(void) {
+    for (uint32_t soff = 0; soff < 8; soff++) {
+        for (uint32_t doff = 0; doff < 8; doff++) {
+            for (uint32_t l = 0; l < NUM_LENGTHS; l++) {
+                uint32_t len = lengths[l];
+                fill(src, BUF_SIZE, soff * 8 + doff);
+                guard(dst);
+                guard(expect);
+                for (uint32_t i = 0; i < len; i++) expect[16 + doff + i] = src[16 + soff + i];
+
+                void* ret = memcpy(dst + 16 + doff, src + 16 + soff, len);
+                CHECK(ret == dst + 16 + doff, "memcpy return, soff %u doff %u len %u", soff, doff, len);
+                CHECK(same(dst, expect, BUF_SIZE), "memcpy soff %u doff %u len %u", soff, doff, len);
+            }
+        }
+    }
+}
+
+// both directions of overlap, and the non-overlapping cases that go through memcpy
+static void test_memmove(void) {
+    for (int delta = -40; delta <= 40; delta++) {
+        for (uint32_t off = 0; off < 4; off++) {
+            for (uint32_t l = 0; l < NUM_LENGTHS; l++) {
+                uint32_t len = lengths[l];
+                if (len > 1024) continue;
+
+                uint32_t from = 64 + off;
+                uint32_t to = from + delta;
+                fill(dst, BUF_SIZE, len + off);
+                for (uint32_t i = 0; i < BUF_SIZE; i++) expect[i] = dst[i];
+                for (uint32_t i = 0; i < len; i++) src[i] = dst[from + i];
+                for (uint32_t i = 0; i < len; i++) expect[to + i] = src[i];
+
+                void* ret = memmove(dst + to, dst + from, len);
+                CHECK(ret == dst + to, "memmove return, delta %d len %u", delta, len);
+                CHECK(same(dst, expect, BUF_SIZE), "memmove delta %d off %u len %u", delta, off, len);
+            }
+        }
+    }
+}
+
+static void test_memcmp(void) {
+    fill(src, 256, 3);
+    for (uint32_t i = 0; i < 256; i++) dst[i] = src[i];
+    CHECK(memcmp(dst, src, 256) == 0, "memcmp equal");
+    CHECK(memcmp(dst, src, 0) == 0, "memcmp empty");
+
+    for (uint32_t at = 0; at < 256; at += 17) {
+        dst[at] = src[at] + 1;
+        CHECK(memcmp(dst, src, 256) > 0, "memcmp greater at %u", at);
+        CHECK(memcmp(src, dst, 256) < 0, "memcmp less at %u", at);
+        CHECK(memcmp(dst, src, at) == 0, "memcmp stops before %u", at);
+        dst[at] = src[at];
+    }
+
+    // unsigned bytes, 0x80 sorts above 0x7F
+    dst[0] = 0x80;
+    src[0] = 0x7F;
+    CHECK(memcmp(dst, src, 1) > 0, "memcmp compares unsigned");
+}
+
+int main(void) {
+    test_memset();
+    test_memcpy();
+    test_memmove();
+    test_memcmp();
+
+    return check_done("mem_test");
+}
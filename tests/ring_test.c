@@ -0,0 +1,131 @@
+// include/kernel/ring.h single threaded: empty/full, a full ring refusing pushes instead
+// of overwriting, the free running counters wrapping past UINT32_MAX, and the batch calls
+// stopping at the end of the array.
+#include <stdio.h>
+#include <stdint.h>
+#include <kernel/ring.h>
+#include "check.h"
+
+#define SLOTS 8
+
+// both counters start at `start`, as if that many elements had already gone through
+static void ring_at(struct ring* r, uint32_t* slots, uint32_t start) {
+    ring_init(r, slots, sizeof(uint32_t), SLOTS);
+    r->head = start;
+    r->tail = start;
+}
+
+static void test_empty_full(uint32_t start) {
+    uint32_t slots[SLOTS], v;
+    struct ring r;
+    ring_at(&r, slots, start);
+
+    CHECK(ring_empty(&r) && !ring_full(&r), "new ring not empty, start %u", start);
+    CHECK(ring_pop(&r, &v) == -1 && ring_peek(&r) == NULL, "pop from empty, start %u", start);
+
+    for (uint32_t i = 0; i < SLOTS; i++) {
+        CHECK(ring_push(&r, &i) == 0, "push %u, start %u", i, start);
+        CHECK(ring_count(&r) == i + 1, "count after push %u, start %u", i, start);
+    }
+    CHECK(ring_full(&r) && !ring_empty(&r), "not full after %d pushes, start %u", SLOTS, start);
+
+    // full means refused, nothing already in there gets overwritten
+    uint32_t extra = 0xDEAD;
+    CHECK(ring_push(&r, &extra) == -1 && ring_reserve(&r) == NULL, "push into full ring, start %u", start);
+    CHECK(ring_count(&r) == SLOTS, "count changed by refused push, start %u", start);
+
+    for (uint32_t i = 0; i < SLOTS; i++) {
+        CHECK(ring_pop(&r, &v) == 0 && v == i, "pop %u got %u, start %u", i, v, start);
+    }
+    CHECK(ring_empty(&r), "not empty after draining, start %u", start);
+}
+
+// keep it half full for a few laps so every slot is reused with the counters wrapping
+static void test_fifo(uint32_t start) {
+    uint32_t slots[SLOTS], v;
+    struct ring r;
+    ring_at(&r, slots, start);
+
+    uint32_t pushed = 0, popped = 0;
+    for (uint32_t step = 0; step < SLOTS * 5; step++) {
+        for (int n = 0; n < 3; n++, pushed++) {
+            if (ring_push(&r, &pushed) != 0) break;
+        }
+        for (int n = 0; n < 2 && ring_pop(&r, &v) == 0; n++, popped++) {
+            CHECK(v == popped, "fifo order, start %u: want %u got %u", start, popped, v);
+        }
+        CHECK(ring_count(&r) == pushed - popped, "count, start %u step %u", start, step);
+    }
+    while (ring_pop(&r, &v) == 0) {
+        CHECK(v == popped, "fifo drain, start %u: want %u got %u", start, popped, v);
+        popped++;
+    }
+    CHECK(popped == pushed, "lost elements, start %u: %u of %u", start, popped, pushed);
+}
+
+static void test_batch(uint32_t start) {
+    uint32_t slots[SLOTS];
+    struct ring r;
+    ring_at(&r, slots, start);
+    uint32_t pos = start & (SLOTS - 1);
+    void* slot;
+
+    // first reserve stops at the end of the array, the next one carries on from slot 0
+    uint32_t got = ring_reserve_batch(&r, SLOTS, &slot);
+    CHECK(got == SLOTS - pos && slot == &slots[pos], "reserve to the wrap, start %u got %u", start, got);
+    for (uint32_t i = 0; i < got; i++) ((uint32_t*)slot)[i] = 100 + i;
+    ring_commit(&r, got);
+
+    uint32_t rest = ring_reserve_batch(&r, SLOTS, &slot);
+    CHECK(rest == pos && (!rest || slot == &slots[0]), "reserve after the wrap, start %u got %u", start, rest);
+    for (uint32_t i = 0; i < rest; i++) ((uint32_t*)slot)[i] = 100 + got + i;
+    ring_commit(&r, rest);
+    CHECK(ring_full(&r), "batches didn't fill it, start %u", start);
+
+    // peeking is capped the same way and sees what was committed
+    uint32_t n = ring_peek_batch(&r, SLOTS, &slot);
+    CHECK(n == SLOTS - pos, "peek to the wrap, start %u got %u", start, n);
+    for (uint32_t i = 0; i < n; i++) CHECK(((uint32_t*)slot)[i] == 100 + i, "peek value %u, start %u", i, start);
+    ring_release(&r, n);
+
+    n = ring_peek_batch(&r, SLOTS, &slot);
+    CHECK(n == pos, "peek after the wrap, start %u got %u", start, n);
+    for (uint32_t i = 0; i < n; i++) CHECK(((uint32_t*)slot)[i] == 100 + got + i, "peek value %u, start %u", got + i, start);
+    ring_release(&r, n);
+    CHECK(ring_empty(&r), "not empty after batches, start %u", start);
+
+    // asking for less than is there only hands out that much
+    ring_push(&r, &n);
+    ring_push(&r, &n);
+    CHECK(ring_peek_batch(&r, 1, &slot) == 1, "peek_batch(1), start %u", start);
+    CHECK(ring_reserve_batch(&r, 1, &slot) == 1, "reserve_batch(1), start %u", start);
+}
+
+struct wide { uint32_t a, b, c; };
+
+static void test_static_init(void) {
+    static struct wide slots[4];
+    struct ring r = RING_INIT(slots);
+    CHECK(ring_capacity(&r) == 4 && r.elem_size == sizeof(struct wide), "RING_INIT sizes");
+
+    struct wide in = {1, 2, 3}, out = {0, 0, 0};
+    CHECK(ring_push(&r, &in) == 0 && ring_pop(&r, &out) == 0, "RING_INIT push/pop");
+    CHECK(out.a == 1 && out.b == 2 && out.c == 3, "RING_INIT element copy");
+
+    CHECK(RING_IS_POW2(1) && RING_IS_POW2(64) && !RING_IS_POW2(0) && !RING_IS_POW2(12), "RING_IS_POW2");
+}
+
+int main(void) {
+    // from zero, and from just under the wrap of the counters at every slot offset
+    static const uint32_t starts[] = {
+        0, 3, UINT32_MAX - SLOTS, UINT32_MAX - 5, UINT32_MAX - 1, UINT32_MAX, UINT32_MAX - SLOTS * 2 + 3,
+    };
+    for (uint32_t i = 0; i < sizeof(starts) / sizeof(starts[0]); i++) {
+        test_empty_full(starts[i]);
+        test_fifo(starts[i]);
+        test_batch(starts[i]);
+    }
+    test_static_init();
+
+    return check_done("ring_test");
+}
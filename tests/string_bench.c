@@ -0,0 +1,76 @@
+// The word-at-a-time string routines against the byte loops they replaced, on the two
+// kinds of strings the kernel mostly sees: short path components and long log lines.
+// Host numbers only say which way it goes, the A8 has to be measured on the board.
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+unsigned int kstrlen(const char* str);
+char* kstrchr(const char* str, int c);
+int kstrcmp(const char* str1, const char* str2);
+
+// what utils.c had before
+static unsigned int byte_strlen(const char* str) {
+    unsigned int len = 0;
+    while (str[len]) len++;
+    return len;
+}
+
+static char* byte_strchr(const char* str, int c) {
+    while (*str != (char)c) {
+        if (!*str++) return NULL;
+    }
+    return (char*)str;
+}
+
+static int byte_strcmp(const char* str1, const char* str2) {
+    while (*str1 && *str1 == *str2) {
+        str1++;
+        str2++;
+    }
+    return (uint8_t)*str1 - (uint8_t)*str2;
+}
+
+#define ROUNDS 2000000
+
+static const char* paths[] = {"bin", "sh", "SWAPFILE", "elf", "dev", "tty0", "boot", "kernel.lz4"};
+#define NUM_PATHS (sizeof(paths) / sizeof(paths[0]))
+
+static char line[] = "[    12.345678] INFO  sched: pid 17 exited with status 0, reaping from parent 1 after 3 ticks";
+static char line_copy[sizeof(line)];
+
+static volatile uintptr_t sink;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#define BENCH(name, expr) do { \
+    uint64_t start = now_ns(); \
+    for (uint32_t r = 0; r < ROUNDS; r++) sink += (uintptr_t)(expr); \
+    uint64_t ns = now_ns() - start; \
+    printf("  %-28s %7.2f ns/call\n", name, (double)ns / ROUNDS); \
+} while (0)
+
+int main(void) {
+    for (uint32_t i = 0; i < sizeof(line); i++) line_copy[i] = line[i];
+
+    printf("short (path components)\n");
+    BENCH("strlen kernel", kstrlen(paths[r % NUM_PATHS]));
+    BENCH("strlen bytes", byte_strlen(paths[r % NUM_PATHS]));
+    BENCH("strchr kernel", kstrchr(paths[r % NUM_PATHS], '/'));
+    BENCH("strchr bytes", byte_strchr(paths[r % NUM_PATHS], '/'));
+    BENCH("strcmp kernel", kstrcmp(paths[r % NUM_PATHS], paths[(r + 1) % NUM_PATHS]));
+    BENCH("strcmp bytes", byte_strcmp(paths[r % NUM_PATHS], paths[(r + 1) % NUM_PATHS]));
+
+    printf("long (%u byte log line)\n", (unsigned)sizeof(line) - 1);
+    BENCH("strlen kernel", kstrlen(line + (r & 3)));
+    BENCH("strlen bytes", byte_strlen(line + (r & 3)));
+    BENCH("strchr kernel", kstrchr(line + (r & 3), '\n'));
+    BENCH("strchr bytes", byte_strchr(line + (r & 3), '\n'));
+    BENCH("strcmp kernel", kstrcmp(line + (r & 3), line_copy + (r & 3)));
+    BENCH("strcmp bytes", byte_strcmp(line + (r & 3), line_copy + (r & 3)));
+    return 0;
+}
@@ -0,0 +1,133 @@
+// strlen/strchr/strcmp/strncmp/strtok from kernel/src/utils.c against the host libc, at every
+// alignment of the strings (and of the two strings against each other) so the byte heads,
+// the word loops and the byte tails all get hit.
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "check.h"
+
+// the kernel's, renamed by KERNEL_NAMES when utils.c is built. Plain names here are libc.
+unsigned int kstrlen(const char* str);
+char* kstrchr(const char* str, int c);
+int kstrcmp(const char* str1, const char* str2);
+int kstrncmp(const char* str1, const char* str2, unsigned int n);
+char* kstrtok(char* str, const char* delim);
+
+#define MAX_LEN 80
+
+static char buf1[MAX_LEN + 16], buf2[MAX_LEN + 16];
+
+static int sign(int v) {
+    return (v > 0) - (v < 0);
+}
+
+// printable, no zero bytes, and some high bit ones so signedness shows up
+static char pick(uint32_t i) {
+    static const char chars[] = "abcdefghijklmnopqrstuvwxyz/._-0123456789\x80\xA5\xFF";
+    return chars[(i * 7 + 3) % (sizeof(chars) - 1)];
+}
+
+// a string of len chars at buf + off, with junk after the terminator
+static char* place(char* buf, uint32_t off, uint32_t len) {
+    memset(buf, 'Z', sizeof(buf1));
+    for (uint32_t i = 0; i < len; i++) buf[off + i] = pick(i);
+    buf[off + len] = '\0';
+    return buf + off;
+}
+
+static void test_strlen(void) {
+    for (uint32_t off = 0; off < 8; off++) {
+        for (uint32_t len = 0; len <= MAX_LEN; len++) {
+            char* s = place(buf1, off, len);
+            CHECK(kstrlen(s) == len, "strlen off %u len %u got %u", off, len, kstrlen(s));
+        }
+    }
+}
+
+static void test_strchr(void) {
+    static const int extra[] = {'\0', 'Z', 0x80, 0xFF, -1, 0x100 + 'a'};
+    for (uint32_t off = 0; off < 8; off++) {
+        for (uint32_t len = 0; len <= 40; len++) {
+            char* s = place(buf1, off, len);
+
+            // every char that's in there, first hit has to match
+            for (uint32_t i = 0; i < len; i++) {
+                int c = (uint8_t)s[i];
+                CHECK(kstrchr(s, c) == strchr(s, c), "strchr off %u len %u c 0x%x", off, len, c);
+            }
+            for (uint32_t i = 0; i < sizeof(extra) / sizeof(extra[0]); i++) {
+                CHECK(kstrchr(s, extra[i]) == strchr(s, extra[i]), "strchr off %u len %u c %d", off, len, extra[i]);
+            }
+        }
+    }
+}
+
+static void test_strcmp(void) {
+    for (uint32_t off1 = 0; off1 < 4; off1++) {
+        for (uint32_t off2 = 0; off2 < 4; off2++) {
+            for (uint32_t len = 0; len <= 40; len++) {
+                char* a = place(buf1, off1, len);
+                char* b = place(buf2, off2, len);
+                CHECK(kstrcmp(a, b) == 0, "strcmp equal off %u/%u len %u", off1, off2, len);
+                CHECK(kstrncmp(a, b, len + 5) == 0, "strncmp equal off %u/%u len %u", off1, off2, len);
+
+                // differ at every position, both ways round, and check n either side of it
+                for (uint32_t at = 0; at < len; at++) {
+                    char saved = b[at];
+                    b[at] = (char)(saved + 1);
+                    CHECK(sign(kstrcmp(a, b)) == sign(strcmp(a, b)), "strcmp off %u/%u len %u at %u", off1, off2, len, at);
+                    CHECK(sign(kstrcmp(b, a)) == sign(strcmp(b, a)), "strcmp rev off %u/%u len %u at %u", off1, off2, len, at);
+                    for (uint32_t n = 0; n <= len + 1; n++) {
+                        CHECK(sign(kstrncmp(a, b, n)) == sign(strncmp(a, b, n)),
+                              "strncmp off %u/%u len %u at %u n %u", off1, off2, len, at, n);
+                    }
+                    b[at] = saved;
+                }
+
+                // one a prefix of the other
+                if (len) {
+                    b[len - 1] = '\0';
+                    CHECK(sign(kstrcmp(a, b)) == 1, "strcmp prefix off %u/%u len %u", off1, off2, len);
+                    CHECK(sign(kstrcmp(b, a)) == -1, "strcmp prefix rev off %u/%u len %u", off1, off2, len);
+                    CHECK(sign(kstrncmp(a, b, len)) == 1, "strncmp prefix off %u/%u len %u", off1, off2, len);
+                    CHECK(kstrncmp(a, b, len - 1) == 0, "strncmp prefix short n off %u/%u len %u", off1, off2, len);
+                }
+            }
+        }
+    }
+}
+
+static void test_strtok(void) {
+    static const char* inputs[] = {
+        "", "/", "///", "a", "/bin/sh", "//usr//lib/", "  leading and  trailing  ",
+        "no-delims-at-all-in-this-one", "/a/bb/ccc/dddd/eeeee/ffffff/", " \t/mixed\t/ delims ",
+    };
+    static const char* delims[] = {"/", " ", " \t/", "\xFF"};
+    char mine[64], theirs[64];
+
+    for (uint32_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+        for (uint32_t d = 0; d < sizeof(delims) / sizeof(delims[0]); d++) {
+            strcpy(mine, inputs[i]);
+            strcpy(theirs, inputs[i]);
+
+            char* k = kstrtok(mine, delims[d]);
+            char* l = strtok(theirs, delims[d]);
+            for (int n = 0; ; n++) {
+                CHECK((k == NULL) == (l == NULL), "strtok \"%s\" token %d presence", inputs[i], n);
+                if (!k || !l) break;
+                CHECK(k - mine == l - theirs && strcmp(k, l) == 0, "strtok \"%s\" token %d: \"%s\" vs \"%s\"", inputs[i], n, k, l);
+                k = kstrtok(NULL, delims[d]);
+                l = strtok(NULL, delims[d]);
+            }
+        }
+    }
+}
+
+int main(void) {
+    test_strlen();
+    test_strchr();
+    test_strcmp();
+    test_strtok();
+
+    return check_done("string_test");
+}
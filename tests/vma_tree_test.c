@@ -0,0 +1,187 @@
+// kernel/src/vma_tree.c against a brute force walk of the sorted list. Random areas are added,
+// removed and resized, and after every step the tree has to be balanced, agree with the list,
+// and give the same answers for lookups and gap searches as a linear scan.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <kernel/vma.h>
+#include "check.h"
+
+#define MAX_AREAS 300
+#define STEPS     20000
+#define SPACE     0x00400000u  // areas live in [PAGE_SIZE, SPACE)
+
+static struct vm_area areas[MAX_AREAS];
+static int used[MAX_AREAS];
+static struct mm mm;
+
+static uint32_t rnd(uint32_t n) {
+    return (uint32_t)rand() % n;
+}
+
+// checks n's subtree, returns its height
+static uint32_t check_node(struct vm_area* n, struct vm_area* parent, uint32_t* count) {
+    if (!n) return 0;
+    (*count)++;
+    CHECK(n->parent == parent, "parent pointer of [%x, %x)", n->start, n->end);
+    if (n->left) CHECK(n->left->start < n->start, "left child out of order at %x", n->start);
+    if (n->right) CHECK(n->right->start > n->start, "right child out of order at %x", n->start);
+
+    uint32_t hl = check_node(n->left, n, count);
+    uint32_t hr = check_node(n->right, n, count);
+    CHECK(hl <= hr + 1 && hr <= hl + 1, "unbalanced at %x: %u vs %u", n->start, hl, hr);
+
+    uint32_t h = 1 + (hl > hr ? hl : hr);
+    CHECK(n->height == h, "height at %x: %u, want %u", n->start, n->height, h);
+
+    uint32_t g = n->gap;
+    if (n->left && n->left->max_gap > g) g = n->left->max_gap;
+    if (n->right && n->right->max_gap > g) g = n->right->max_gap;
+    CHECK(n->max_gap == g, "max_gap at %x: %u, want %u", n->start, n->max_gap, g);
+    return h;
+}
+
+static void check_tree(void) {
+    uint32_t count = 0;
+    check_node(mm.tree, NULL, &count);
+
+    // the list is in order, and every gap is the space down to the area before
+    uint32_t listed = 0, prev_end = 0;
+    struct vm_area* vma;
+    list_for_each_entry(vma, struct vm_area, &mm.vmas, list) {
+        CHECK(vma->start >= prev_end && vma->start < vma->end, "list order at %x", vma->start);
+        CHECK(vma->gap == vma->start - prev_end, "gap at %x: %u, want %u", vma->start, vma->gap, vma->start - prev_end);
+        prev_end = vma->end;
+        listed++;
+    }
+    CHECK(listed == count, "list has %u areas, tree %u", listed, count);
+}
+
+static struct vm_area* slow_find(uint32_t addr) {
+    struct vm_area* vma;
+    list_for_each_entry(vma, struct vm_area, &mm.vmas, list) {
+        if (addr >= vma->start && addr < vma->end) return vma;
+    }
+    return NULL;
+}
+
+static struct vm_area* slow_above(uint32_t addr) {
+    struct vm_area* vma;
+    list_for_each_entry(vma, struct vm_area, &mm.vmas, list) {
+        if (vma->end > addr) return vma;
+    }
+    return NULL;
+}
+
+// first fit by walking the sorted list
+static uint32_t slow_gap(uint32_t len, uint32_t lo, uint32_t hi) {
+    if (!len || lo > hi || hi - lo < len) return 0;
+    uint32_t addr = lo;
+    struct vm_area* vma;
+    list_for_each_entry(vma, struct vm_area, &mm.vmas, list) {
+        if (vma->end <= addr) continue;
+        if (vma->start >= addr + len) break;
+        addr = vma->end;
+    }
+    return (addr + len <= hi) ? addr : 0;
+}
+
+static struct vm_area* random_area(void) {
+    if (!mm.num_vmas) return NULL;
+    for (;;) {
+        uint32_t i = rnd(MAX_AREAS);
+        if (used[i]) return &areas[i];
+    }
+}
+
+static void add_area(void) {
+    uint32_t i;
+    for (i = 0; i < MAX_AREAS && used[i]; i++);
+    if (i == MAX_AREAS) return;
+
+    uint32_t start = (1 + rnd(SPACE / PAGE_SIZE - 2)) * PAGE_SIZE;
+    uint32_t end = start + (1 + rnd(8)) * PAGE_SIZE;
+    if (end > SPACE) return;
+
+    struct vm_area* next = vma_tree_above(&mm, start);
+    if (next && next->start < end) return; // overlaps, vma_create says -EEXIST here
+
+    areas[i].start = start;
+    areas[i].end = end;
+    vma_tree_link(&mm, &areas[i]);
+    used[i] = 1;
+    mm.num_vmas++;
+}
+
+static void remove_area(void) {
+    struct vm_area* vma = random_area();
+    if (!vma) return;
+    vma_tree_unlink(&mm, vma);
+    used[vma - areas] = 0;
+    mm.num_vmas--;
+}
+
+// move one end by a page or two, never into a neighbour, like brk, stack growth and unmap do
+static void resize_area(void) {
+    struct vm_area* vma = random_area();
+    if (!vma) return;
+
+    struct vm_area* prev = (vma->list.prev == &mm.vmas) ? NULL : list_entry(vma->list.prev, struct vm_area, list);
+    struct vm_area* next = (vma->list.next == &mm.vmas) ? NULL : list_entry(vma->list.next, struct vm_area, list);
+    uint32_t lo = prev ? prev->end : PAGE_SIZE;
+    uint32_t hi = next ? next->start : SPACE;
+    int delta = ((int)rnd(5) - 2) * PAGE_SIZE;
+
+    if (rnd(2)) {
+        uint32_t start = vma->start + delta;
+        if (start < lo || start >= vma->end) return;
+        vma->start = start;
+    } else {
+        uint32_t end = vma->end + delta;
+        if (end > hi || end <= vma->start) return;
+        vma->end = end;
+    }
+    vma_tree_resized(&mm, vma);
+}
+
+static void check_queries(void) {
+    for (int q = 0; q < 20; q++) {
+        uint32_t addr = rnd(SPACE + PAGE_SIZE);
+        CHECK(vma_tree_find(&mm, addr) == slow_find(addr), "find %x", addr);
+        CHECK(vma_tree_above(&mm, addr) == slow_above(addr), "above %x", addr);
+
+        uint32_t len = (1 + rnd(rnd(2) ? 4 : 64)) * PAGE_SIZE;
+        uint32_t lo = rnd(SPACE / PAGE_SIZE) * PAGE_SIZE;
+        uint32_t hi = lo + rnd(SPACE / PAGE_SIZE) * PAGE_SIZE;
+        uint32_t got = vma_tree_gap(&mm, len, lo, hi), want = slow_gap(len, lo, hi);
+        CHECK(got == want, "gap len %x in [%x, %x): %x, want %x", len, lo, hi, got, want);
+    }
+}
+
+int main(void) {
+    srand(432);
+
+    // fill up, churn, drain, twice, so the tree is checked at every size on the way
+    for (int round = 0; round < 2; round++) {
+        INIT_LIST_HEAD(&mm.vmas);
+        mm.tree = NULL;
+        mm.num_vmas = 0;
+
+        for (int step = 0; step < STEPS; step++) {
+            uint32_t op = rnd(10);
+            int filling = step < STEPS / 2;
+            if (op < (filling ? 6u : 3u)) add_area();
+            else if (op < 7) remove_area();
+            else resize_area();
+
+            check_tree();
+            check_queries();
+            if (failures) break;
+        }
+        while (mm.num_vmas) remove_area();
+        CHECK(mm.tree == NULL && list_empty(&mm.vmas), "not empty after draining");
+        if (failures) break;
+    }
+
+    return check_done("vma_tree_test");
+}
@@ -8,6 +8,7 @@
 #define EEXIST 17
 #define EBADF 9
 #define ENOTSUP 95
+#define ENOTTY 25
 
 
 // #define errno (*__errno_location()) // TODO
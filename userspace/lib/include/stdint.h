@@ -11,5 +11,8 @@ typedef signed int int32_t;
 typedef signed short int16_t;
 typedef signed char int8_t;
 
+typedef signed int intptr_t;
+typedef unsigned int uintptr_t;
+
 
 #endif /* __LIB_STDINT_H__ */
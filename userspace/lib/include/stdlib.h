@@ -1,6 +1,12 @@
 #ifndef __LIB_STDLIB_H__
 #define __LIB_STDLIB_H__
 
+#include <stddef.h>
 
+// malloc owns the brk heap, don't mix it with sbrk calls of your own
+void* malloc(size_t size);
+void free(void* ptr);
+void* calloc(size_t count, size_t size);
+void* realloc(void* ptr, size_t size);
 
 #endif
@@ -7,5 +7,7 @@ int strlen(const char *str);
 int strcpy(char *dest, const char *src);
 int memcmp(const char* a, const char* b, size_t bytes);
 int strcmp(const char *a, const char *b);
+void* memset(void* dest, int value, size_t bytes);
+void* memcpy(void* dest, const void* src, size_t bytes);
 
 #endif
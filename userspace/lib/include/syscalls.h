@@ -19,6 +19,12 @@
 #define SYSCALL_USLEEP_NO 13
 #define SYSCALL_LSEEK_NO 14
 #define SYSCALL_WAITPID_NO 15
+#define SYSCALL_IOCTL_NO 17
+#define SYSCALL_SPAWN_NO 18
+#define SYSCALL_VFORK_NO 19
+#define SYSCALL_BRK_NO 20
+#define SYSCALL_MMAP_NO 21
+#define SYSCALL_MUNMAP_NO 22
 
 
 #define OPEN_MODE_READ      0x01
@@ -36,6 +42,32 @@
 
 #define EAGAIN 11
 
+// /dev/tty modes and ioctls, stdin is a tty
+#define TTY_MODE_CANON   0x01
+#define TTY_MODE_ECHO    0x02
+#define TTY_IOCTL_GET_MODE 0x5401
+#define TTY_IOCTL_SET_MODE 0x5402
+
+
+// spawn() file actions, applied in order to the child's copy of our fds
+#define SPAWN_FD_END   0
+#define SPAWN_FD_CLOSE 1  // close fd
+#define SPAWN_FD_DUP2  2  // fd becomes a copy of src
+
+struct spawn_fd_action {
+    int action;
+    int fd;
+    int src;
+};
+
+// mmap, anonymous private mappings only
+#define PROT_READ     0x1
+#define PROT_WRITE    0x2
+#define PROT_EXEC     0x4
+#define MAP_PRIVATE   0x02
+#define MAP_FIXED     0x10
+#define MAP_ANONYMOUS 0x20
+#define MAP_FAILED    ((void*)-1)
 
 typedef struct dirent {
     uint32_t d_ino;    // Inode number
@@ -103,6 +135,23 @@ static inline __attribute__((always_inline)) uint32_t syscall_3(uint32_t syscall
     return retval;
 }
 
+static inline __attribute__((always_inline)) uint32_t syscall_4(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4) {
+    uint32_t retval;
+    __asm__ volatile (
+        "mov r7, %[syscall_num]   \n"  // Set syscall number (r7)
+        "mov r0, %[arg1]          \n"  // Set arg1 (r0)
+        "mov r1, %[arg2]          \n"  // Set arg2 (r1)
+        "mov r2, %[arg3]          \n"  // Set arg3 (r2)
+        "mov r3, %[arg4]          \n"  // Set arg4 (r3)
+        "svc #0                   \n"  // Trigger the syscall
+        "mov %[retval], r0        \n"  // Move return value from r0 to retval
+        : [retval] "=r" (retval)    // Output operand: store the value of r0 in retval
+        : [syscall_num] "r" (syscall_num), [arg1] "r" (arg1), [arg2] "r" (arg2), [arg3] "r" (arg3), [arg4] "r" (arg4)
+        : "r0", "r1", "r2", "r3", "r7"  // Clobbered registers
+    );
+    return retval;
+}
+
 
 void syscall_debug(const char *str, uint32_t len);
 
@@ -122,10 +171,28 @@ ssize_t write(int fd, const void *buf, size_t count);
 int lseek(int fd, int offset, int mode);
 int usleep(uint64_t usec);
 int waitpid(int pid);
+int ioctl(int fd, uint32_t cmd, uint32_t arg);
+
+// the heap, pages come in as they're first touched
+int brk(void* addr);
+void* sbrk(intptr_t increment);  // (void*)-1 when the heap can't grow
+void* mmap(void* addr, size_t len, int prot, int flags);
+int munmap(void* addr, size_t len);
 
 // very basic exec
 int exec(const char* path);
 
+// start path as a new child without copying this process first, returns its pid.
+// actions can be NULL to just inherit every fd
+int spawn(const char* path, char* const argv[], char* const envp[], const struct spawn_fd_action* actions);
+
+// The child runs on our memory and stack until it calls exec or exit, and we're suspended
+// until then. Inlined so the svc happens in the caller's frame: a vfork() function of its
+// own would have its saved registers overwritten by the child's next call.
+static inline __attribute__((always_inline)) int vfork(void) {
+    return syscall_0(SYSCALL_VFORK_NO);
+}
+
 
 
 
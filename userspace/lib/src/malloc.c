@@ -0,0 +1,247 @@
+// malloc/free on top of sbrk and mmap.
+//
+// Small requests are rounded up to a size class and carved out of 64KB spans on the brk
+// heap. Every span is SPAN_SIZE aligned and starts with its header, so free() finds the
+// span (and with it the size) from the pointer alone, no per object header. A span hands
+// out objects from its free list first and then bumps through memory it never touched,
+// so a new span only costs the pages that actually get used.
+//
+// A span that empties out goes on a shared free list for any class to reuse, lowest address
+// first so the heap stays packed at the bottom. Free spans at the top of the heap are given
+// back with sbrk, all but one, so an alloc/free pair on an empty heap doesn't turn into two
+// syscalls. Anything bigger than the largest class gets its own mmap and goes straight back
+// with munmap.
+//
+// There are no threads, so no locking and no per thread caches: the fast path is a pop
+// off the first partial span of the class.
+#include <stdlib.h>
+#include <string.h>
+#include <syscalls.h>
+
+#define SPAN_SIZE   (64 * 1024)
+#define SPAN_FREE   0xFFFF
+#define PAGE_SIZE   4096
+#define ALIGNMENT   16
+
+static const uint16_t class_sizes[] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096, 6144, 8192,
+};
+
+#define NUM_CLASSES (sizeof(class_sizes) / sizeof(class_sizes[0]))
+#define MAX_SMALL   8192
+
+struct span {
+    struct span* next;      // partial list of its class, or the free span list
+    struct span* prev;
+    void* free;             // freed objects, linked through their first word
+    char* bump;             // first object never handed out
+    uint16_t size_class;    // SPAN_FREE while on the free span list
+    uint16_t used;
+};
+
+#define SPAN_HEADER ((sizeof(struct span) + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
+
+// mmap'd blocks, the header sits right before the pointer handed out
+struct large {
+    size_t size;            // whole mapping, header included
+    uint32_t pad[3];        // keeps the pointer 16 byte aligned
+};
+
+static struct span* partial[NUM_CLASSES];
+static struct span* free_spans; // sorted by address
+static char* heap_start;   // spans live in [heap_start, heap_end)
+static char* heap_end;
+
+static uint8_t size_to_class[MAX_SMALL / ALIGNMENT + 1]; // (size + 15) / 16 -> class
+static int initialized;
+
+static int malloc_init(void) {
+    uint32_t c = 0;
+    for (uint32_t i = 0; i <= MAX_SMALL / ALIGNMENT; i++) {
+        while (class_sizes[c] < i * ALIGNMENT) c++;
+        size_to_class[i] = c;
+    }
+
+    // spans have to be SPAN_SIZE aligned, burn whatever's below the first boundary
+    // if that fails spans would be handed out from under a misaligned break, so don't start at all
+    char* brk = sbrk(0);
+    if (brk == (void*)-1) return -1;
+    uint32_t pad = -(uintptr_t)brk & (SPAN_SIZE - 1);
+    if (pad && sbrk(pad) == (void*)-1) return -1;
+
+    heap_start = heap_end = brk + pad;
+    initialized = 1;
+    return 0;
+}
+
+static inline struct span* span_of(void* ptr) {
+    return (struct span*)((uintptr_t)ptr & ~(SPAN_SIZE - 1));
+}
+
+static inline int in_heap(void* ptr) {
+    return (char*)ptr >= heap_start && (char*)ptr < heap_end;
+}
+
+static void list_push(struct span** head, struct span* s) {
+    s->prev = NULL;
+    s->next = *head;
+    if (*head) (*head)->prev = s;
+    *head = s;
+}
+
+static void list_remove(struct span** head, struct span* s) {
+    if (s->prev) s->prev->next = s->next;
+    else *head = s->next;
+    if (s->next) s->next->prev = s->prev;
+}
+
+static void free_list_insert(struct span* s) {
+    struct span** pos = &free_spans;
+    struct span* prev = NULL;
+    while (*pos && *pos < s) {
+        prev = *pos;
+        pos = &(*pos)->next;
+    }
+
+    s->next = *pos;
+    s->prev = prev;
+    if (*pos) (*pos)->prev = s;
+    *pos = s;
+}
+
+static inline int span_is_free(char* addr) {
+    return addr >= heap_start && ((struct span*)addr)->size_class == SPAN_FREE;
+}
+
+// give free spans at the top of the heap back to the kernel, keeping the last one as a spare
+static void heap_trim(void) {
+    while (span_is_free(heap_end - SPAN_SIZE) && span_is_free(heap_end - 2 * SPAN_SIZE)) {
+        struct span* top = (struct span*)(heap_end - SPAN_SIZE);
+        if (sbrk(-SPAN_SIZE) == (void*)-1) break;
+
+        list_remove(&free_spans, top);
+        heap_end -= SPAN_SIZE;
+    }
+}
+
+static struct span* span_alloc(uint32_t size_class) {
+    struct span* s = free_spans;
+    if (s) {
+        list_remove(&free_spans, s);
+    } else {
+        s = sbrk(SPAN_SIZE);
+        if (s == (void*)-1) return NULL;
+        heap_end += SPAN_SIZE;
+    }
+
+    s->free = NULL;
+    s->bump = (char*)s + SPAN_HEADER;
+    s->size_class = size_class;
+    s->used = 0;
+    list_push(&partial[size_class], s);
+    return s;
+}
+
+static void span_release(struct span* s) {
+    list_remove(&partial[s->size_class], s);
+    s->size_class = SPAN_FREE;
+    free_list_insert(s);
+    heap_trim();
+}
+
+static inline int span_full(struct span* s) {
+    return !s->free && s->bump + class_sizes[s->size_class] > (char*)s + SPAN_SIZE;
+}
+
+static void* malloc_small(size_t size) {
+    uint32_t c = size_to_class[(size + ALIGNMENT - 1) / ALIGNMENT];
+    struct span* s = partial[c];
+    if (!s && !(s = span_alloc(c))) return NULL;
+
+    void* obj;
+    if (s->free) {
+        obj = s->free;
+        s->free = *(void**)obj;
+    } else {
+        obj = s->bump;
+        s->bump += class_sizes[c];
+    }
+    s->used++;
+
+    if (span_full(s)) list_remove(&partial[c], s);
+    return obj;
+}
+
+static void free_small(void* ptr) {
+    struct span* s = span_of(ptr);
+    int was_full = span_full(s);
+
+    *(void**)ptr = s->free;
+    s->free = ptr;
+    s->used--;
+
+    if (was_full) list_push(&partial[s->size_class], s);
+    if (s->used == 0) span_release(s);
+}
+
+static void* malloc_large(size_t size) {
+    if (size > 0x7FFFF000 - sizeof(struct large)) return NULL;
+
+    size_t total = (size + sizeof(struct large) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    struct large* block = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS);
+    if (block == MAP_FAILED) return NULL;
+
+    block->size = total;
+    return block + 1;
+}
+
+static inline size_t usable_size(void* ptr) {
+    if (in_heap(ptr)) return class_sizes[span_of(ptr)->size_class];
+    return ((struct large*)ptr - 1)->size - sizeof(struct large);
+}
+
+void* malloc(size_t size) {
+    if (!initialized && malloc_init() != 0) return NULL;
+    if (size == 0) size = 1;
+
+    return size <= MAX_SMALL ? malloc_small(size) : malloc_large(size);
+}
+
+void free(void* ptr) {
+    if (!ptr) return;
+
+    if (in_heap(ptr)) {
+        free_small(ptr);
+    } else {
+        struct large* block = (struct large*)ptr - 1;
+        munmap(block, block->size);
+    }
+}
+
+void* calloc(size_t count, size_t size) {
+    if (size && count > (size_t)-1 / size) return NULL;
+
+    size_t total = count * size;
+    void* ptr = malloc(total);
+    // fresh mappings are already zero, only recycled heap memory needs clearing
+    if (ptr && in_heap(ptr)) memset(ptr, 0, total);
+    return ptr;
+}
+
+void* realloc(void* ptr, size_t size) {
+    if (!ptr) return malloc(size);
+    if (size == 0) {
+        free(ptr);
+        return NULL;
+    }
+
+    size_t old_size = usable_size(ptr);
+    if (size <= old_size) return ptr;
+
+    void* new_ptr = malloc(size);
+    if (!new_ptr) return NULL;
+
+    memcpy(new_ptr, ptr, old_size);
+    free(ptr);
+    return new_ptr;
+}
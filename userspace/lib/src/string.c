@@ -35,3 +35,16 @@ int memcmp(const char* a, const char* b, size_t bytes) {
     }
     return 0;
 }
+
+void* memset(void* dest, int value, size_t bytes) {
+    unsigned char* d = dest;
+    while (bytes--) *d++ = (unsigned char)value;
+    return dest;
+}
+
+void* memcpy(void* dest, const void* src, size_t bytes) {
+    unsigned char* d = dest;
+    const unsigned char* s = src;
+    while (bytes--) *d++ = *s++;
+    return dest;
+}
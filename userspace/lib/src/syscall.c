@@ -70,6 +70,47 @@ int exec(const char* path) {
     return syscall_1(SYSCALL_EXEC_NO, (uint32_t) path);
 }
 
+int spawn(const char* path, char* const argv[], char* const envp[], const struct spawn_fd_action* actions) {
+    return syscall_4(SYSCALL_SPAWN_NO, (uint32_t) path, (uint32_t) argv, (uint32_t) envp, (uint32_t) actions);
+}
+
 int waitpid(int pid) {
     return syscall_1(SYSCALL_WAITPID_NO, pid);
 }
+
+int ioctl(int fd, uint32_t cmd, uint32_t arg) {
+    return syscall_3(SYSCALL_IOCTL_NO, fd, cmd, arg);
+}
+
+// the kernel hands back the break it ended up with, which is the old one on failure. An errno
+// instead (vfork child) means nothing moved, so it's never cached
+static uintptr_t current_brk;
+
+int brk(void* addr) {
+    uint32_t ret = syscall_1(SYSCALL_BRK_NO, (uint32_t) addr);
+    if (ret >= (uint32_t)-4095) return -1;
+
+    current_brk = ret;
+    return current_brk == (uintptr_t) addr ? 0 : -1;
+}
+
+void* sbrk(intptr_t increment) {
+    if (!current_brk) {
+        uint32_t ret = syscall_1(SYSCALL_BRK_NO, 0);
+        if (ret >= (uint32_t)-4095) return (void*)-1;
+        current_brk = ret;
+    }
+
+    uintptr_t old = current_brk;
+    if (increment && brk((void*)(old + increment)) != 0) return (void*)-1;
+    return (void*) old;
+}
+
+void* mmap(void* addr, size_t len, int prot, int flags) {
+    uint32_t ret = syscall_4(SYSCALL_MMAP_NO, (uint32_t) addr, len, prot, flags);
+    return ret >= (uint32_t)-4095 ? MAP_FAILED : (void*) ret;
+}
+
+int munmap(void* addr, size_t len) {
+    return syscall_2(SYSCALL_MUNMAP_NO, (uint32_t) addr, len);
+}
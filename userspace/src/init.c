@@ -16,7 +16,7 @@ int main() {
     }
     else if (pid == 0) {
         // Child process
-        int res = exec("/mnt/elf/sh");
+        int res = exec("/elf/sh");
         fprintf(stderr, "exec failed with code %d\n", res);
         exit(1);
     }
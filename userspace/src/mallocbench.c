@@ -0,0 +1,112 @@
+// malloc/free cost for a few allocation patterns, and how much heap is still held once
+// everything has been freed again
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscalls.h>
+#include <time.h>
+
+#define PAIR_ROUNDS  20000
+#define BATCH_COUNT  2000
+#define BATCH_ROUNDS 10
+#define LARGE_ROUNDS 200
+#define LARGE_SIZE   (64 * 1024)
+
+static void* slots[BATCH_COUNT];
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void) {
+    rng_state = rng_state * 1103515245 + 12345;
+    return rng_state >> 16;
+}
+
+static uint64_t now_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void report(const char* name, uint64_t start, uint32_t ops) {
+    uint32_t ns = (uint32_t)((now_us() - start) * 1000 / ops);
+    printf("%s: %d ns per op\n", name, ns);
+}
+
+// the same small block over and over, the free path straight back into the fast path
+static void bench_pairs(void) {
+    uint64_t start = now_us();
+    for (int i = 0; i < PAIR_ROUNDS; i++) {
+        char* p = malloc(32);
+        p[0] = i;
+        free(p);
+    }
+    report("malloc+free 32B", start, PAIR_ROUNDS);
+}
+
+// a few thousand live objects of mixed sizes, freed in random order
+static void bench_batch(void) {
+    uint64_t start = now_us();
+    for (int round = 0; round < BATCH_ROUNDS; round++) {
+        for (int i = 0; i < BATCH_COUNT; i++) {
+            slots[i] = malloc(16 + rng() % 497);
+            if (!slots[i]) {
+                printf("batch: out of memory at %d\n", i);
+                return;
+            }
+        }
+
+        for (int i = BATCH_COUNT - 1; i > 0; i--) {
+            int j = rng() % (i + 1);
+            void* tmp = slots[i];
+            slots[i] = slots[j];
+            slots[j] = tmp;
+        }
+
+        for (int i = 0; i < BATCH_COUNT; i++) free(slots[i]);
+    }
+    report("mixed 16-512B", start, BATCH_COUNT * BATCH_ROUNDS * 2);
+}
+
+// a growing buffer, each step has to move to a bigger class and eventually to mmap
+static void bench_realloc(void) {
+    uint64_t start = now_us();
+    uint32_t ops = 0;
+    for (int round = 0; round < BATCH_ROUNDS; round++) {
+        char* buf = NULL;
+        for (size_t size = 16; size <= LARGE_SIZE; size *= 2) {
+            buf = realloc(buf, size);
+            buf[size - 1] = 1;
+            ops++;
+        }
+        free(buf);
+    }
+    report("realloc 16B-64KB", start, ops);
+}
+
+// big enough to get a mapping of its own every time
+static void bench_large(void) {
+    uint64_t start = now_us();
+    for (int i = 0; i < LARGE_ROUNDS; i++) {
+        char* p = malloc(LARGE_SIZE);
+        if (!p) {
+            printf("large: out of memory\n");
+            return;
+        }
+        p[0] = 1;
+        p[LARGE_SIZE - 1] = 1;
+        free(p);
+    }
+    report("malloc+free 64KB", start, LARGE_ROUNDS);
+}
+
+int main(void) {
+    char* heap_start = sbrk(0);
+
+    bench_pairs();
+    bench_batch();
+    bench_realloc();
+    bench_large();
+
+    uint32_t held = (char*)sbrk(0) - heap_start;
+    printf("heap still held after freeing everything: %d KB\n", held / 1024);
+    return 0;
+}
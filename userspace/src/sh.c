@@ -4,9 +4,9 @@
 #include <string.h>
 #include <syscalls.h>
 
-#define BIN_PATH "/mnt/elf"
+#define BIN_PATH "/elf"
 
-#define BUF_SIZE 64
+#define BUF_SIZE 256
 #define PROMPT "> "
 
 typedef int (*builtin_func)(int, char **);
@@ -25,10 +25,10 @@ typedef struct {
 #include <syscalls.h>
 
 // for now, path is hardcoded. later we will get it from the environment with getenv syscall.
-#define PATH "/mnt/elf"
+#define PATH "/elf"
 
 
-#define BUF_SIZE 64
+#define BUF_SIZE 256 // TTY_LINE_MAX, so a whole line fits in one read
 #define PROMPT "> "
 
 int cmd_exit(int argc, char **argv) {
@@ -191,88 +191,48 @@ builtin_func find_builtin(char *cmd) {
 
 int main(void) {
     char buf[BUF_SIZE];
-    size_t pos = 0;
 
     printf("Welcome to the shell!\n");
 
-    // Write initial prompt
-    write(stdout, PROMPT, strlen(PROMPT));
-
     while (1) {
-        // Try to read one character
-        char c;
-        ssize_t rc = read(stdin, &c, 1);
-
-        if (rc == -EAGAIN) {
-            usleep(1000);
-            continue;
-        }
+        write(stdout, PROMPT, strlen(PROMPT));
 
+        // stdin is a canonical tty, the kernel does the editing and echo and hands back a line
+        ssize_t rc = read(stdin, buf, BUF_SIZE - 1);
         if (rc <= 0) {
-            // Error or EOF, restart
-            pos = 0;
-            write(stdout, "\n" PROMPT, strlen("\n" PROMPT));
-            continue;
-        }
-
-        if (c == '\b' || c == 0x7F) { // backspace
-            if (pos > 0) {
-                pos--;
-                write(stdout, "\b \b", 3);
-            }
+            write(stdout, "\n", 1);
             continue;
         }
 
-        // Handle enter
-        if (c == '\n' || c == '\r') {
-            if (pos == 0) {
-                write(stdout, "\n"PROMPT, strlen("\n"PROMPT));
-                continue;
-            }
-            buf[pos] = '\0';
-            write(stdout, "\n", 1);
+        buf[rc] = '\0';
+        if (buf[rc - 1] == '\n') buf[rc - 1] = '\0';
+        if (buf[0] == '\0') continue;
 
-            char *argv[4] = {0};
-            char *token = buf;
-            int argc = 0;
+        char *argv[4] = {0};
+        char *token = buf;
+        int argc = 0;
 
-            while (*token && argc < 3) {
-                argv[argc++] = token;
-                while (*token && *token != ' ') token++;
-                if (*token) *token++ = '\0';
-            }
+        while (*token && argc < 3) {
+            argv[argc++] = token;
+            while (*token && *token != ' ') token++;
+            if (*token) *token++ = '\0';
+        }
 
-            // Fork and exec if file exists, else print error
-            builtin_func builtin = find_builtin(argv[0]);
-            if (builtin) {
-                builtin(argc, argv);
+        // Fork and exec if file exists, else print error
+        builtin_func builtin = find_builtin(argv[0]);
+        if (builtin) {
+            builtin(argc, argv);
+        } else {
+            // Execute external program, spawn builds it straight from the ELF so the shell
+            // never gets copied just to be replaced
+            char exec_path[128];
+            snprintf(exec_path, sizeof(exec_path), "%s/%s", PATH, argv[0]);
+            int pid = spawn(exec_path, argv, NULL, NULL);
+            if (pid < 0) {
+                printf("File %s not found (or spawn failed: %d)!\n", argv[0], pid);
             } else {
-                // Execute external program
-                int pid = fork();
-                if (pid < 0) return -1;
-                if (pid == 0) {
-                    char exec_path[128];
-                    snprintf(exec_path, sizeof(exec_path), "%s/%s", PATH, argv[0]);
-                    // for now, just exec and fail. later we can use access syscall to check if file exists.
-                    if (exec(exec_path) != 0) {
-                        printf("File %s not found (or exec failed!)!\n", argv[0]);
-                    }
-                    exit(1);
-                } else {
-                    waitpid(pid);
-                }
+                waitpid(pid);
             }
-
-
-            // Reset for next command
-            pos = 0;
-            write(stdout, PROMPT, strlen(PROMPT));
-            continue;
-        }
-
-        if (pos < BUF_SIZE-1 && c >= 32 && c <= 126) {
-            buf[pos++] = c;
-            write(stdout, &c, 1);
         }
     }
 
@@ -0,0 +1,66 @@
+// launch latency of fork+exec against vfork+exec and spawn, each one runs /elf/true and
+// waits for it
+#include <stdio.h>
+#include <syscalls.h>
+#include <time.h>
+
+#define TARGET "/elf/true"
+#define ROUNDS 32
+
+enum launch_mode { LAUNCH_FORK, LAUNCH_VFORK, LAUNCH_SPAWN };
+
+static const char* launch_names[] = { "fork+exec", "vfork+exec", "spawn" };
+
+static uint64_t now_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static int launch(enum launch_mode mode) {
+    int pid;
+
+    switch (mode) {
+        case LAUNCH_FORK:
+            pid = fork();
+            if (pid == 0) {
+                exec(TARGET);
+                exit(1);
+            }
+            break;
+        case LAUNCH_VFORK:
+            pid = vfork();
+            if (pid == 0) {
+                exec(TARGET);
+                exit(1);
+            }
+            break;
+        default:
+            pid = spawn(TARGET, NULL, NULL, NULL);
+            break;
+    }
+
+    if (pid < 0) return pid;
+    return waitpid(pid);
+}
+
+int main(void) {
+    printf("spawnbench: %d launches of %s each\n", ROUNDS, TARGET);
+
+    for (int mode = LAUNCH_FORK; mode <= LAUNCH_SPAWN; mode++) {
+        uint64_t start = now_us();
+
+        for (int i = 0; i < ROUNDS; i++) {
+            int status = launch(mode);
+            if (status != 0) {
+                printf("%s: launch %d failed (%d)\n", launch_names[mode], i, status);
+                return 1;
+            }
+        }
+
+        uint32_t per_launch = (uint32_t)((now_us() - start) / ROUNDS);
+        printf("%s: %d us per launch\n", launch_names[mode], per_launch);
+    }
+
+    return 0;
+}
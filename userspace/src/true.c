@@ -0,0 +1,4 @@
+// does nothing and exits 0, the smallest thing there is to launch
+int main(void) {
+    return 0;
+}